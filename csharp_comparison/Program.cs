@@ -1,13 +1,46 @@
 using System.Diagnostics;
+using System.Globalization;
+using System.Runtime.InteropServices;
 using System.Runtime.Intrinsics;
 using System.Runtime.Intrinsics.X86;
+using System.Text.Json;
 
 namespace Seventy.ComputerEnhance.Sum;
 
 internal static class Program
 {
     private const int NumRuns = 100; // Number of runs for measuring minimum cycle count
-    private const double CpuFrequencyGHz = 4.4; // Assume an approximate CPU frequency in GHz
+    private const int TimerOverheadRuns = 10000; // Empty TSC read pairs used to estimate the timer overhead
+
+    // libsum.so from the Makefile, copied next to the assembly by Sum.csproj. It supplies the clock
+    // every runner reports in, the C kernels, and sum_u64 as the FFI call whose overhead is charted
+    private const string SumLibrary = "sum";
+
+    // The TSC reads are tiny leaf functions, so they skip the GC transition to keep the timed region tight
+    [DllImport(SumLibrary, EntryPoint = "sum_tsc_begin"), SuppressGCTransition]
+    private static extern ulong TscBegin();
+
+    [DllImport(SumLibrary, EntryPoint = "sum_tsc_end"), SuppressGCTransition]
+    private static extern ulong TscEnd();
+
+    [DllImport(SumLibrary, EntryPoint = "sum_tsc_hz")]
+    private static extern double TscHz();
+
+    [DllImport(SumLibrary, EntryPoint = "sum_u64")]
+    private static extern unsafe ulong SumU64(ulong* data, nuint count);
+
+    [DllImport(SumLibrary, EntryPoint = "sum_measure_cycles")]
+    private static extern unsafe ulong CMeasureCycles(string name, ulong* data, nuint count, int runs, out ulong result);
+
+    // C kernels timed inside the library on the same buffer as the C# loops; the ones this CPU
+    // can't run are skipped
+    private static readonly string[] CKernels =
+        ["SingleScalar", "Unroll2Scalar", "Unroll4Scalar", "Simd256", "Simd256x4", "Simd512x4", "SumU64"];
+
+    private static double TscFrequencyHz;
+
+    // Cycles of an empty TscBegin/TscEnd pair, subtracted from every sample like the C harness does
+    private static ulong TimerOverhead;
 
     private static ulong SingleScalar(ulong count, ulong[] inputData)
     {
@@ -195,53 +228,239 @@ internal static class Program
     }
 
 
-    private static double MeasureCycles(Func<ulong, ulong[], ulong> func, ulong count, ulong[] inputData, out double elapsedTimeSeconds)
+    private static ulong MeasureTimerOverhead()
+    {
+        var minCycles = ulong.MaxValue;
+        for (var run = 0; run < TimerOverheadRuns; run++)
+        {
+            var start = TscBegin();
+            minCycles = Math.Min(minCycles, TscEnd() - start);
+        }
+        return minCycles;
+    }
+
+    private static ulong MeasureCycles(Func<ulong, ulong[], ulong> func, ulong count, ulong[] inputData)
     {
-        var minTicks = long.MaxValue;
+        var minCycles = ulong.MaxValue;
 
         for (var run = 0; run < NumRuns; run++)
         {
-            var startTicks = Stopwatch.GetTimestamp();
+            var start = TscBegin();
             func(count, inputData);
-            var endTicks = Stopwatch.GetTimestamp();
+            var cycles = TscEnd() - start;
 
-            var elapsedTicks = endTicks - startTicks;
-            minTicks = Math.Min(minTicks, elapsedTicks);
+            minCycles = Math.Min(minCycles, cycles > TimerOverhead ? cycles - TimerOverhead : 1);
         }
 
-        elapsedTimeSeconds = minTicks / (double)Stopwatch.Frequency;
-        return elapsedTimeSeconds * CpuFrequencyGHz * 1e9;
+        return minCycles;
     }
 
-    private static void RunTest(string funcName, Func<ulong, ulong[], ulong> func, ulong[] sizes)
+    // sum_u64 through P/Invoke, timed from C# so the cycles include the call and the transition
+    private static unsafe ulong FfiSumU64(ulong count, ulong[] inputData)
+    {
+        fixed (ulong* dataPtr = inputData)
+        {
+            return SumU64(dataPtr, (nuint)count);
+        }
+    }
+
+    // Input 0, 1, 2, ... on the pinned object heap, so the C kernels read it in place
+    private static ulong[] PinnedInput(ulong size)
+    {
+        var inputData = GC.AllocateUninitializedArray<ulong>((int)size, pinned: true);
+        for (ulong i = 0; i < size; i++)
+        {
+            inputData[i] = i;
+        }
+        return inputData;
+    }
+
+    // Columns shared with the C and Python runners, so `./sum --baseline` can read any of the reports
+    private static readonly string[] CsvColumns =
+        ["runner", "kernel", "size", "result", "time_s", "min_cycles", "adds_per_cycle", "runs", "cpu_model", "tsc_hz", "compiler", "cflags"];
+
+    private static readonly List<Dictionary<string, object>> Records = [];
+
+    private static string OutputFormat { get; set; } = "text";
+
+    private static void PrintHeader(string funcName)
     {
         Console.WriteLine($"\nRunning tests for function: {funcName}");
         Console.WriteLine(new string('=', 100));
         Console.WriteLine("{0,-20}{1,-25}{2,-20}{3,-15}{4,-15}", "Test Size", "Result", "Time Taken (s)", "CPU Cycles", "Adds per Cycle");
         Console.WriteLine(new string('-', 100));
+    }
+
+    private static void AddResult(string funcName, ulong size, ulong result, ulong cycles)
+    {
+        var elapsedTimeSeconds = cycles / TscFrequencyHz;
+        var addsPerCycle = size / (double)cycles;
+
+        if (OutputFormat == "text")
+        {
+            Console.WriteLine("{0,-20}{1,-25}{2,-20:F6}{3,-15}{4,-15:F6}", size, result, elapsedTimeSeconds, cycles, addsPerCycle);
+            return;
+        }
+
+        Records.Add(new Dictionary<string, object>
+        {
+            ["runner"] = "csharp",
+            ["kernel"] = funcName,
+            ["size"] = size,
+            ["result"] = result,
+            ["time_s"] = elapsedTimeSeconds,
+            ["min_cycles"] = cycles,
+            ["adds_per_cycle"] = Math.Round(addsPerCycle, 6),
+            ["runs"] = NumRuns
+        });
+    }
+
+    private static void RunTest(string funcName, Func<ulong, ulong[], ulong> func, ulong[] sizes)
+    {
+        var text = OutputFormat == "text";
+        if (text)
+        {
+            PrintHeader(funcName);
+        }
 
         foreach (var size in sizes)
         {
-            var inputData = new ulong[size];
-            for (ulong i = 0; i < size; i++)
+            var inputData = PinnedInput(size);
+            var cycles = MeasureCycles(func, size, inputData);
+            AddResult(funcName, size, func(size, inputData), cycles);
+        }
+
+        if (text)
+        {
+            Console.WriteLine(new string('=', 100));
+        }
+    }
+
+    // Function to time a C kernel inside libsum on a C# buffer, skipped when the CPU can't run it
+    private static unsafe void RunCTest(string kernel, ulong[] sizes)
+    {
+        var text = OutputFormat == "text";
+        var header = false;
+
+        foreach (var size in sizes)
+        {
+            var inputData = PinnedInput(size);
+            ulong result, cycles;
+            fixed (ulong* dataPtr = inputData)
             {
-                inputData[i] = i;
+                cycles = CMeasureCycles(kernel, dataPtr, (nuint)size, NumRuns, out result);
             }
+            if (cycles == 0)
+            {
+                return;
+            }
+            if (text && !header)
+            {
+                PrintHeader($"C:{kernel}");
+                header = true;
+            }
+            AddResult($"C:{kernel}", size, result, cycles);
+        }
 
-            var cycles = MeasureCycles(func, size, inputData, out var elapsedTimeSeconds);
-            var addsPerCycle = size / cycles;
-            var result = func(size, inputData);
+        if (header)
+        {
+            Console.WriteLine(new string('=', 100));
+        }
+    }
 
-            Console.WriteLine("{0,-20}{1,-25}{2,-20:F6}{3,-15:F0}{4,-15:F6}", size, result, elapsedTimeSeconds, cycles, addsPerCycle);
+    // Function to chart what calling into C costs: sum_u64 timed from C# across P/Invoke against
+    // the same call timed inside the library, on one buffer, with one clock
+    private static unsafe void PrintFfiOverhead(TextWriter log, ulong[] sizes)
+    {
+        log.WriteLine("\nFFI overhead of sum_u64 (P/Invoke, cycles):");
+        log.WriteLine("{0,-20}{1,-15}{2,-15}{3,-15}", "Test Size", "In C", "From C#", "Overhead");
+        foreach (var size in sizes.Prepend(0UL))
+        {
+            var inputData = PinnedInput(Math.Max(size, 1));
+            ulong inC;
+            fixed (ulong* dataPtr = inputData)
+            {
+                inC = CMeasureCycles("SumU64", dataPtr, (nuint)size, NumRuns, out _);
+            }
+            var fromCSharp = MeasureCycles(FfiSumU64, size, inputData);
+            log.WriteLine("{0,-20}{1,-15}{2,-15}{3,-15}", size, inC, fromCSharp, (long)fromCSharp - (long)inC);
         }
+    }
 
-        Console.WriteLine(new string('=', 100));
+    private static string CpuModel()
+    {
+        if (File.Exists("/proc/cpuinfo"))
+        {
+            var modelLine = File.ReadLines("/proc/cpuinfo").FirstOrDefault(line => line.StartsWith("model name"));
+            if (modelLine != null)
+            {
+                return modelLine[(modelLine.IndexOf(':') + 1)..].Trim().Replace(',', ' ');
+            }
+        }
+
+        return Environment.GetEnvironmentVariable("PROCESSOR_IDENTIFIER")?.Replace(',', ' ') ?? "unknown";
     }
 
-    private static void Main()
+    private static void PrintRecords()
     {
+        var host = new Dictionary<string, object>
+        {
+            ["cpu_model"] = CpuModel(),
+            ["tsc_hz"] = Math.Round(TscFrequencyHz),
+            ["compiler"] = RuntimeInformation.FrameworkDescription,
+            ["cflags"] = Debugger.IsAttached ? "debugger attached" : "jit"
+        };
+
+        if (OutputFormat == "json")
+        {
+            // Same layout as the C harness: one record per line
+            Console.WriteLine($"{{\"runner\": \"csharp\", \"host\": {JsonSerializer.Serialize(host)},");
+            Console.WriteLine("\"results\": [");
+            Console.WriteLine(string.Join(",\n", Records.Select(record => "  " + JsonSerializer.Serialize(record))));
+            Console.WriteLine("]}");
+        }
+        else if (OutputFormat == "csv")
+        {
+            Console.WriteLine(string.Join(',', CsvColumns));
+            foreach (var record in Records)
+            {
+                var row = CsvColumns.Select(column => record.TryGetValue(column, out var value) ? value : host[column]);
+                Console.WriteLine(string.Join(',', row.Select(value => Convert.ToString(value, CultureInfo.InvariantCulture))));
+            }
+        }
+    }
+
+    private static int Main(string[] args)
+    {
+        foreach (var arg in args)
+        {
+            if (arg is "--format=text" or "--format=json" or "--format=csv")
+            {
+                OutputFormat = arg["--format=".Length..];
+                continue;
+            }
+
+            Console.Error.WriteLine("Usage: dotnet run -- [--format=text|json|csv]");
+            return 1;
+        }
+
         ulong[] testSizes = [5000, 20000, 312500, 6000000, 25000000];
 
+        // Keep stdout machine-readable for json and csv
+        var log = OutputFormat == "text" ? Console.Out : Console.Error;
+        try
+        {
+            TscFrequencyHz = TscHz();
+        }
+        catch (DllNotFoundException)
+        {
+            Console.Error.WriteLine("Error: libsum.so not found, build it with `make libsum.so` next to Sum.csproj");
+            return 1;
+        }
+        TimerOverhead = MeasureTimerOverhead();
+        log.WriteLine($"TSC frequency: {TscFrequencyHz:F0} Hz (from libsum)");
+        log.WriteLine($"Timer overhead: {TimerOverhead} cycles (subtracted from every measurement)");
+
         RunTest("SingleScalar", SingleScalar, testSizes);
         RunTest("LinqSum", LinqSum, testSizes);
         RunTest("LinqAggregate", LinqAggregate, testSizes);
@@ -251,5 +470,14 @@ internal static class Program
         RunTest("ParallelUnroll4Scalar", ParallelUnroll4Scalar, testSizes);
         RunTest("Simd256", Simd256, testSizes);
         RunTest("ParallelUnroll4Simd256", ParallelUnroll4Simd256, testSizes);
+        foreach (var kernel in CKernels)
+        {
+            RunCTest(kernel, testSizes);
+        }
+        RunTest("FfiSumU64", FfiSumU64, testSizes);
+        PrintFfiOverhead(log, testSizes);
+
+        PrintRecords();
+        return 0;
     }
 }
\ No newline at end of file
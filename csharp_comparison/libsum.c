@@ -0,0 +1,2065 @@
+#define _GNU_SOURCE  // For sched_getaffinity and pthread_setaffinity_np
+
+// The summation kernels, their registry and the worker pool the parallel kernels run on, built into
+// libsum.a and libsum.so and linked into every build of the benchmark in sum.c; see sum.h for the API
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <cpuid.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+#include "sum_internal.h"
+
+int num_threads = 1;  // Thread count used by the parallel kernels, set by the caller before pool_init
+uint64_t prefetch_distance = DEFAULT_PREFETCH_DISTANCE / sizeof(uint64_t);  // In elements
+
+// Function to perform addition using uint64_t
+uint64_t SingleScalar(uint64_t count, uint64_t* input_data) {
+    uint64_t total_sum = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        total_sum += input_data[i];
+    }
+    return total_sum;
+}
+
+// Generates UnrollNScalar: N independent accumulators so the adds don't serialize through one
+// register, and a remainder loop for counts that aren't a multiple of N
+#define DEFINE_UNROLL_SCALAR(N)                                      \
+uint64_t Unroll##N##Scalar(uint64_t count, uint64_t* input_data) {  \
+    uint64_t sums[N] = {0};                                          \
+    uint64_t i;                                                      \
+    for (i = 0; i + N <= count; i += N) {                            \
+        _Pragma("GCC unroll 16")                                     \
+        for (int k = 0; k < N; k++) {                                \
+            sums[k] += input_data[i + k];                            \
+        }                                                            \
+    }                                                                \
+    for (; i < count; i++) {                                         \
+        sums[0] += input_data[i];                                    \
+    }                                                                \
+    uint64_t total_sum = 0;                                          \
+    _Pragma("GCC unroll 16")                                         \
+    for (int k = 0; k < N; k++) {                                    \
+        total_sum += sums[k];                                        \
+    }                                                                \
+    return total_sum;                                                \
+}
+
+DEFINE_UNROLL_SCALAR(2)
+DEFINE_UNROLL_SCALAR(4)
+DEFINE_UNROLL_SCALAR(8)
+DEFINE_UNROLL_SCALAR(16)
+
+// Function to perform addition using SIMD with SSE2 for 64-bit integers
+uint64_t __attribute__((target("sse2"))) Simd128(uint64_t count, uint64_t* input_data) {
+    __m128i total_sum = _mm_setzero_si128();
+    uint64_t i;
+    for (i = 0; i + 2 <= count; i += 2) {
+        __m128i data = _mm_loadu_si128((__m128i*)&input_data[i]);
+        total_sum = _mm_add_epi64(total_sum, data);
+    }
+    uint64_t result[2];
+    _mm_storeu_si128((__m128i*)result, total_sum);
+    uint64_t final_sum = result[0] + result[1];
+
+    for (; i < count; i++) {
+        final_sum += input_data[i];
+    }
+    return final_sum;
+}
+
+// Function to perform addition using SIMD with AVX2 for 64-bit integers
+uint64_t __attribute__((target("avx2"))) Simd256(uint64_t count, uint64_t* input_data) {
+    __m256i total_sum = _mm256_setzero_si256();
+    uint64_t i;
+    for (i = 0; i + 4 <= count; i += 4) {
+        __m256i data = _mm256_loadu_si256((__m256i*)&input_data[i]);
+        total_sum = _mm256_add_epi64(total_sum, data);
+    }
+    uint64_t result[4];
+    _mm256_storeu_si256((__m256i*)result, total_sum);
+    uint64_t final_sum = result[0] + result[1] + result[2] + result[3];
+
+    for (; i < count; i++) {
+        final_sum += input_data[i];
+    }
+    return final_sum;
+}
+
+// Function to perform addition using AVX2 with 4 independent accumulators to hide the vpaddq latency
+uint64_t __attribute__((target("avx2"))) Simd256x4(uint64_t count, uint64_t* input_data) {
+    __m256i sum0 = _mm256_setzero_si256();
+    __m256i sum1 = _mm256_setzero_si256();
+    __m256i sum2 = _mm256_setzero_si256();
+    __m256i sum3 = _mm256_setzero_si256();
+    uint64_t i;
+    for (i = 0; i + 16 <= count; i += 16) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_loadu_si256((__m256i*)&input_data[i]));
+        sum1 = _mm256_add_epi64(sum1, _mm256_loadu_si256((__m256i*)&input_data[i + 4]));
+        sum2 = _mm256_add_epi64(sum2, _mm256_loadu_si256((__m256i*)&input_data[i + 8]));
+        sum3 = _mm256_add_epi64(sum3, _mm256_loadu_si256((__m256i*)&input_data[i + 12]));
+    }
+    for (; i + 4 <= count; i += 4) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_loadu_si256((__m256i*)&input_data[i]));
+    }
+
+    // Reduce the accumulators pairwise, then horizontally
+    __m256i total_sum = _mm256_add_epi64(_mm256_add_epi64(sum0, sum1), _mm256_add_epi64(sum2, sum3));
+    uint64_t result[4];
+    _mm256_storeu_si256((__m256i*)result, total_sum);
+    uint64_t final_sum = result[0] + result[1] + result[2] + result[3];
+
+    for (; i < count; i++) {
+        final_sum += input_data[i];
+    }
+    return final_sum;
+}
+
+// Function to perform addition using AVX2 with 8 independent accumulators
+uint64_t __attribute__((target("avx2"))) Simd256x8(uint64_t count, uint64_t* input_data) {
+    __m256i sum0 = _mm256_setzero_si256();
+    __m256i sum1 = _mm256_setzero_si256();
+    __m256i sum2 = _mm256_setzero_si256();
+    __m256i sum3 = _mm256_setzero_si256();
+    __m256i sum4 = _mm256_setzero_si256();
+    __m256i sum5 = _mm256_setzero_si256();
+    __m256i sum6 = _mm256_setzero_si256();
+    __m256i sum7 = _mm256_setzero_si256();
+    uint64_t i;
+    for (i = 0; i + 32 <= count; i += 32) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_loadu_si256((__m256i*)&input_data[i]));
+        sum1 = _mm256_add_epi64(sum1, _mm256_loadu_si256((__m256i*)&input_data[i + 4]));
+        sum2 = _mm256_add_epi64(sum2, _mm256_loadu_si256((__m256i*)&input_data[i + 8]));
+        sum3 = _mm256_add_epi64(sum3, _mm256_loadu_si256((__m256i*)&input_data[i + 12]));
+        sum4 = _mm256_add_epi64(sum4, _mm256_loadu_si256((__m256i*)&input_data[i + 16]));
+        sum5 = _mm256_add_epi64(sum5, _mm256_loadu_si256((__m256i*)&input_data[i + 20]));
+        sum6 = _mm256_add_epi64(sum6, _mm256_loadu_si256((__m256i*)&input_data[i + 24]));
+        sum7 = _mm256_add_epi64(sum7, _mm256_loadu_si256((__m256i*)&input_data[i + 28]));
+    }
+    for (; i + 4 <= count; i += 4) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_loadu_si256((__m256i*)&input_data[i]));
+    }
+
+    // Reduce the accumulators as a tree, then horizontally
+    sum0 = _mm256_add_epi64(sum0, sum4);
+    sum1 = _mm256_add_epi64(sum1, sum5);
+    sum2 = _mm256_add_epi64(sum2, sum6);
+    sum3 = _mm256_add_epi64(sum3, sum7);
+    __m256i total_sum = _mm256_add_epi64(_mm256_add_epi64(sum0, sum1), _mm256_add_epi64(sum2, sum3));
+    uint64_t result[4];
+    _mm256_storeu_si256((__m256i*)result, total_sum);
+    uint64_t final_sum = result[0] + result[1] + result[2] + result[3];
+
+    for (; i < count; i++) {
+        final_sum += input_data[i];
+    }
+    return final_sum;
+}
+
+// Generates Simd256x4 variants that prefetch prefetch_distance elements ahead with the given hint,
+// one prefetch per cache line; prefetches past the end of the buffer are harmless
+#define DEFINE_SIMD256_PREFETCH(name, hint)                                                             \
+uint64_t __attribute__((target("avx2"))) name(uint64_t count, uint64_t* input_data) {                 \
+    __m256i sum0 = _mm256_setzero_si256();                                                              \
+    __m256i sum1 = _mm256_setzero_si256();                                                              \
+    __m256i sum2 = _mm256_setzero_si256();                                                              \
+    __m256i sum3 = _mm256_setzero_si256();                                                              \
+    uint64_t distance = prefetch_distance;                                                              \
+    uint64_t i;                                                                                         \
+    for (i = 0; i + 16 <= count; i += 16) {                                                             \
+        _mm_prefetch((const char*)&input_data[i + distance], hint);                                     \
+        _mm_prefetch((const char*)&input_data[i + distance + 8], hint);                                 \
+        sum0 = _mm256_add_epi64(sum0, _mm256_loadu_si256((__m256i*)&input_data[i]));                  \
+        sum1 = _mm256_add_epi64(sum1, _mm256_loadu_si256((__m256i*)&input_data[i + 4]));              \
+        sum2 = _mm256_add_epi64(sum2, _mm256_loadu_si256((__m256i*)&input_data[i + 8]));              \
+        sum3 = _mm256_add_epi64(sum3, _mm256_loadu_si256((__m256i*)&input_data[i + 12]));             \
+    }                                                                                                   \
+    __m256i total_sum = _mm256_add_epi64(_mm256_add_epi64(sum0, sum1), _mm256_add_epi64(sum2, sum3));   \
+    uint64_t result[4];                                                                                 \
+    _mm256_storeu_si256((__m256i*)result, total_sum);                                                   \
+    uint64_t final_sum = result[0] + result[1] + result[2] + result[3];                                 \
+    for (; i < count; i++) {                                                                            \
+        final_sum += input_data[i];                                                                     \
+    }                                                                                                   \
+    return final_sum;                                                                                   \
+}
+
+DEFINE_SIMD256_PREFETCH(Simd256x4Prefetch, _MM_HINT_T0)
+DEFINE_SIMD256_PREFETCH(Simd256x4PrefetchNta, _MM_HINT_NTA)
+
+// Function to perform addition using AVX2 non-temporal loads (vmovntdqa). The loads need 32-byte
+// alignment, so a scalar head runs up to the first aligned element. On ordinary write-back memory
+// the CPU may treat them as normal loads, which is exactly what this kernel measures.
+uint64_t __attribute__((target("avx2"))) Simd256x4StreamLoad(uint64_t count, uint64_t* input_data) {
+    uint64_t final_sum = 0;
+    uint64_t i = 0;
+    for (; i < count && ((uintptr_t)&input_data[i] & 31) != 0; i++) {
+        final_sum += input_data[i];
+    }
+
+    __m256i sum0 = _mm256_setzero_si256();
+    __m256i sum1 = _mm256_setzero_si256();
+    __m256i sum2 = _mm256_setzero_si256();
+    __m256i sum3 = _mm256_setzero_si256();
+    for (; i + 16 <= count; i += 16) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_stream_load_si256((__m256i*)&input_data[i]));
+        sum1 = _mm256_add_epi64(sum1, _mm256_stream_load_si256((__m256i*)&input_data[i + 4]));
+        sum2 = _mm256_add_epi64(sum2, _mm256_stream_load_si256((__m256i*)&input_data[i + 8]));
+        sum3 = _mm256_add_epi64(sum3, _mm256_stream_load_si256((__m256i*)&input_data[i + 12]));
+    }
+    __m256i total_sum = _mm256_add_epi64(_mm256_add_epi64(sum0, sum1), _mm256_add_epi64(sum2, sum3));
+    uint64_t result[4];
+    _mm256_storeu_si256((__m256i*)result, total_sum);
+    final_sum += result[0] + result[1] + result[2] + result[3];
+
+    for (; i < count; i++) {
+        final_sum += input_data[i];
+    }
+    return final_sum;
+}
+
+// Function to perform addition using AVX-512, the tail is one masked load instead of a scalar loop
+uint64_t __attribute__((target("avx512f"))) Simd512(uint64_t count, uint64_t* input_data) {
+    __m512i total_sum = _mm512_setzero_si512();
+    uint64_t i;
+    for (i = 0; i + 8 <= count; i += 8) {
+        total_sum = _mm512_add_epi64(total_sum, _mm512_loadu_si512(&input_data[i]));
+    }
+    __mmask8 tail_mask = (__mmask8)((1u << (count - i)) - 1);
+    total_sum = _mm512_add_epi64(total_sum, _mm512_maskz_loadu_epi64(tail_mask, &input_data[i]));
+    return _mm512_reduce_add_epi64(total_sum);
+}
+
+// Function to perform addition using AVX-512 with 4 independent accumulators and a masked tail
+uint64_t __attribute__((target("avx512f"))) Simd512x4(uint64_t count, uint64_t* input_data) {
+    __m512i sum0 = _mm512_setzero_si512();
+    __m512i sum1 = _mm512_setzero_si512();
+    __m512i sum2 = _mm512_setzero_si512();
+    __m512i sum3 = _mm512_setzero_si512();
+    uint64_t i;
+    for (i = 0; i + 32 <= count; i += 32) {
+        sum0 = _mm512_add_epi64(sum0, _mm512_loadu_si512(&input_data[i]));
+        sum1 = _mm512_add_epi64(sum1, _mm512_loadu_si512(&input_data[i + 8]));
+        sum2 = _mm512_add_epi64(sum2, _mm512_loadu_si512(&input_data[i + 16]));
+        sum3 = _mm512_add_epi64(sum3, _mm512_loadu_si512(&input_data[i + 24]));
+    }
+    for (; i + 8 <= count; i += 8) {
+        sum0 = _mm512_add_epi64(sum0, _mm512_loadu_si512(&input_data[i]));
+    }
+    __mmask8 tail_mask = (__mmask8)((1u << (count - i)) - 1);
+    sum1 = _mm512_add_epi64(sum1, _mm512_maskz_loadu_epi64(tail_mask, &input_data[i]));
+
+    __m512i total_sum = _mm512_add_epi64(_mm512_add_epi64(sum0, sum1), _mm512_add_epi64(sum2, sum3));
+    return _mm512_reduce_add_epi64(total_sum);
+}
+
+// The checked kernels return the low 64 bits of the exact sum and store the carry-out word in *high,
+// so the full result is *high * 2^64 + return value (high_word in the SIMD kernels). Their registry forms below drop the high word
+
+// Function to perform addition into a 128-bit accumulator, each add becomes add/adc
+uint64_t Wide128ScalarWide(uint64_t count, uint64_t* input_data, uint64_t* high) {
+    unsigned __int128 total_sum = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        total_sum += input_data[i];
+    }
+    *high = (uint64_t)(total_sum >> 64);
+    return (uint64_t)total_sum;
+}
+
+// Function to perform addition with an explicit overflow check, counting carries into the high word
+uint64_t CheckedScalarWide(uint64_t count, uint64_t* input_data, uint64_t* high) {
+    uint64_t low = 0;
+    *high = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        *high += __builtin_add_overflow(low, input_data[i], &low);
+    }
+    return low;
+}
+
+// Function to add one vector to lane-wise 128-bit accumulators. The low words are kept biased by
+// the sign bit, so AVX2's signed compare sees the unsigned order: a lane carried out exactly when
+// its new low word is below the old one, and the all-ones compare mask is subtracted into the high word
+static inline __attribute__((target("avx2"))) void add_carry256(__m256i* low, __m256i* high, __m256i value) {
+    __m256i sum = _mm256_add_epi64(*low, value);
+    *high = _mm256_sub_epi64(*high, _mm256_cmpgt_epi64(*low, sum));
+    *low = sum;
+}
+
+// Function to perform checked addition using AVX2 with 4 independent 128-bit accumulators
+uint64_t __attribute__((target("avx2"))) CheckedSimd256x4Wide(uint64_t count, uint64_t* input_data, uint64_t* high_word) {
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    __m256i low[4] = {bias, bias, bias, bias};
+    __m256i high[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+    uint64_t i;
+    for (i = 0; i + 16 <= count; i += 16) {
+        add_carry256(&low[0], &high[0], _mm256_loadu_si256((__m256i*)&input_data[i]));
+        add_carry256(&low[1], &high[1], _mm256_loadu_si256((__m256i*)&input_data[i + 4]));
+        add_carry256(&low[2], &high[2], _mm256_loadu_si256((__m256i*)&input_data[i + 8]));
+        add_carry256(&low[3], &high[3], _mm256_loadu_si256((__m256i*)&input_data[i + 12]));
+    }
+    for (; i + 4 <= count; i += 4) {
+        add_carry256(&low[0], &high[0], _mm256_loadu_si256((__m256i*)&input_data[i]));
+    }
+
+    // Remove the bias and combine the sixteen lanes as 128-bit values
+    unsigned __int128 total_sum = 0;
+    for (int k = 0; k < 4; k++) {
+        uint64_t low_words[4], high_words[4];
+        _mm256_storeu_si256((__m256i*)low_words, _mm256_xor_si256(low[k], bias));
+        _mm256_storeu_si256((__m256i*)high_words, high[k]);
+        for (int lane = 0; lane < 4; lane++) {
+            total_sum += ((unsigned __int128)high_words[lane] << 64) | low_words[lane];
+        }
+    }
+    for (; i < count; i++) {
+        total_sum += input_data[i];
+    }
+    *high_word = (uint64_t)(total_sum >> 64);
+    return (uint64_t)total_sum;
+}
+
+// Function to add one vector to lane-wise 128-bit accumulators with AVX-512's unsigned compare,
+// bumping the high word only in the lanes that carried out
+static inline __attribute__((target("avx512f"))) void add_carry512(__m512i* low, __m512i* high, __m512i value) {
+    __m512i sum = _mm512_add_epi64(*low, value);
+    *high = _mm512_mask_add_epi64(*high, _mm512_cmplt_epu64_mask(sum, *low), *high, _mm512_set1_epi64(1));
+    *low = sum;
+}
+
+// Function to perform checked addition using AVX-512 with 4 independent 128-bit accumulators and a masked tail
+uint64_t __attribute__((target("avx512f"))) CheckedSimd512x4Wide(uint64_t count, uint64_t* input_data, uint64_t* high_word) {
+    __m512i low[4] = {_mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512()};
+    __m512i high[4] = {_mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512()};
+    uint64_t i;
+    for (i = 0; i + 32 <= count; i += 32) {
+        add_carry512(&low[0], &high[0], _mm512_loadu_si512(&input_data[i]));
+        add_carry512(&low[1], &high[1], _mm512_loadu_si512(&input_data[i + 8]));
+        add_carry512(&low[2], &high[2], _mm512_loadu_si512(&input_data[i + 16]));
+        add_carry512(&low[3], &high[3], _mm512_loadu_si512(&input_data[i + 24]));
+    }
+    for (; i + 8 <= count; i += 8) {
+        add_carry512(&low[0], &high[0], _mm512_loadu_si512(&input_data[i]));
+    }
+    __mmask8 tail_mask = (__mmask8)((1u << (count - i)) - 1);
+    add_carry512(&low[1], &high[1], _mm512_maskz_loadu_epi64(tail_mask, &input_data[i]));
+
+    unsigned __int128 total_sum = 0;
+    for (int k = 0; k < 4; k++) {
+        uint64_t low_words[8], high_words[8];
+        _mm512_storeu_si512(low_words, low[k]);
+        _mm512_storeu_si512(high_words, high[k]);
+        for (int lane = 0; lane < 8; lane++) {
+            total_sum += ((unsigned __int128)high_words[lane] << 64) | low_words[lane];
+        }
+    }
+    *high_word = (uint64_t)(total_sum >> 64);
+    return (uint64_t)total_sum;
+}
+
+// Generates NAME, the registry form of the checked kernel NAME##Wide, which returns only the low word
+#define DEFINE_LOW_WORD(NAME)                                  \
+uint64_t NAME(uint64_t count, uint64_t* input_data) {          \
+    uint64_t high;                                             \
+    return NAME##Wide(count, input_data, &high);               \
+}
+
+DEFINE_LOW_WORD(Wide128Scalar)
+DEFINE_LOW_WORD(CheckedScalar)
+DEFINE_LOW_WORD(CheckedSimd256x4)
+DEFINE_LOW_WORD(CheckedSimd512x4)
+
+// Function to perform addition that clamps at UINT64_MAX instead of wrapping
+uint64_t SaturatingScalar(uint64_t count, uint64_t* input_data) {
+    uint64_t total_sum = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        total_sum = __builtin_add_overflow(total_sum, input_data[i], &total_sum) ? UINT64_MAX : total_sum;
+    }
+    return total_sum;
+}
+
+// Function to add one vector to biased lane accumulators, pinning lanes that carried out at the
+// biased UINT64_MAX; a pinned lane carries again on every non-zero add, so it stays pinned
+static inline __attribute__((target("avx2"))) __m256i add_saturate256(__m256i low, __m256i value) {
+    __m256i sum = _mm256_add_epi64(low, value);
+    return _mm256_blendv_epi8(sum, _mm256_set1_epi64x(INT64_MAX), _mm256_cmpgt_epi64(low, sum));
+}
+
+// Function to perform saturating addition using AVX2 with 4 independent accumulators
+uint64_t __attribute__((target("avx2"))) SaturatingSimd256x4(uint64_t count, uint64_t* input_data) {
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    __m256i sum0 = bias, sum1 = bias, sum2 = bias, sum3 = bias;
+    uint64_t i;
+    for (i = 0; i + 16 <= count; i += 16) {
+        sum0 = add_saturate256(sum0, _mm256_loadu_si256((__m256i*)&input_data[i]));
+        sum1 = add_saturate256(sum1, _mm256_loadu_si256((__m256i*)&input_data[i + 4]));
+        sum2 = add_saturate256(sum2, _mm256_loadu_si256((__m256i*)&input_data[i + 8]));
+        sum3 = add_saturate256(sum3, _mm256_loadu_si256((__m256i*)&input_data[i + 12]));
+    }
+    for (; i + 4 <= count; i += 4) {
+        sum0 = add_saturate256(sum0, _mm256_loadu_si256((__m256i*)&input_data[i]));
+    }
+
+    // Reduce the accumulators pairwise with the same clamp, then horizontally
+    __m256i sum01 = add_saturate256(sum0, _mm256_xor_si256(sum1, bias));
+    __m256i sum23 = add_saturate256(sum2, _mm256_xor_si256(sum3, bias));
+    __m256i total_sum = add_saturate256(sum01, _mm256_xor_si256(sum23, bias));
+    uint64_t result[4];
+    _mm256_storeu_si256((__m256i*)result, _mm256_xor_si256(total_sum, bias));
+    uint64_t final_sum = 0;
+    for (int lane = 0; lane < 4; lane++) {
+        final_sum = __builtin_add_overflow(final_sum, result[lane], &final_sum) ? UINT64_MAX : final_sum;
+    }
+    for (; i < count; i++) {
+        final_sum = __builtin_add_overflow(final_sum, input_data[i], &final_sum) ? UINT64_MAX : final_sum;
+    }
+    return final_sum;
+}
+
+const element_type element_types[] = {
+    {"u64", sizeof(uint64_t), 0},
+    {"u8", sizeof(uint8_t), 0},
+    {"u16", sizeof(uint16_t), 0},
+    {"u32", sizeof(uint32_t), 0},
+    {"f32", sizeof(float), 1},
+    {"f64", sizeof(double), 1},
+};
+
+// Generates Scalar<SUFFIX>, a four-accumulator scalar sum that widens TYPE into ACC
+#define DEFINE_SCALAR_SUM(SUFFIX, TYPE, ACC, RESULT)                 \
+uint64_t Scalar##SUFFIX(uint64_t count, uint64_t* input_data) {     \
+    const TYPE* data = (const TYPE*)input_data;                      \
+    ACC sums[4] = {0};                                               \
+    uint64_t i;                                                      \
+    for (i = 0; i + 4 <= count; i += 4) {                            \
+        _Pragma("GCC unroll 4")                                      \
+        for (int k = 0; k < 4; k++) {                                \
+            sums[k] += data[i + k];                                  \
+        }                                                            \
+    }                                                                \
+    for (; i < count; i++) {                                         \
+        sums[0] += data[i];                                          \
+    }                                                                \
+    return RESULT((sums[0] + sums[1]) + (sums[2] + sums[3]));        \
+}
+
+DEFINE_SCALAR_SUM(U8, uint8_t, uint64_t, (uint64_t))
+DEFINE_SCALAR_SUM(U16, uint16_t, uint64_t, (uint64_t))
+DEFINE_SCALAR_SUM(U32, uint32_t, uint64_t, (uint64_t))
+DEFINE_SCALAR_SUM(F32, float, double, double_bits)
+DEFINE_SCALAR_SUM(F64, double, double, double_bits)
+
+// Function to reduce four 64-bit integer lanes
+static inline __attribute__((target("avx2"))) uint64_t reduce_epi64(__m256i sum) {
+    uint64_t result[4];
+    _mm256_storeu_si256((__m256i*)result, sum);
+    return (result[0] + result[1]) + (result[2] + result[3]);
+}
+
+// Function to reduce four double lanes in a fixed order
+static inline __attribute__((target("avx2"))) double reduce_pd(__m256d sum) {
+    double result[4];
+    _mm256_storeu_pd(result, sum);
+    return (result[0] + result[1]) + (result[2] + result[3]);
+}
+
+// Function to sum bytes with AVX2: psadbw against zero adds each group of 8 bytes into a 64-bit lane
+uint64_t __attribute__((target("avx2"))) Simd256U8(uint64_t count, uint64_t* input_data) {
+    const uint8_t* data = (const uint8_t*)input_data;
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum0 = zero, sum1 = zero;
+    uint64_t i;
+    for (i = 0; i + 64 <= count; i += 64) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_sad_epu8(_mm256_loadu_si256((__m256i*)&data[i]), zero));
+        sum1 = _mm256_add_epi64(sum1, _mm256_sad_epu8(_mm256_loadu_si256((__m256i*)&data[i + 32]), zero));
+    }
+    for (; i + 32 <= count; i += 32) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_sad_epu8(_mm256_loadu_si256((__m256i*)&data[i]), zero));
+    }
+
+    uint64_t final_sum = reduce_epi64(_mm256_add_epi64(sum0, sum1));
+    for (; i < count; i++) {
+        final_sum += data[i];
+    }
+    return final_sum;
+}
+
+#define U16_BLOCK (8192 * 16)  // Elements per 32-bit accumulation block, keeps every lane below 2^31
+
+// Function to sum 16-bit values with AVX2: pmaddwd against ones adds neighbouring pairs into 32-bit
+// lanes. pmaddwd is signed, so values are biased by -32768 first and the bias is added back at the
+// end; the 32-bit lanes are widened into 64-bit ones after every block
+uint64_t __attribute__((target("avx2"))) Simd256U16(uint64_t count, uint64_t* input_data) {
+    const uint16_t* data = (const uint16_t*)input_data;
+    const __m256i bias = _mm256_set1_epi16((short)0x8000);
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i wide_sum = _mm256_setzero_si256();
+    uint64_t i = 0;
+    while (i + 16 <= count) {
+        uint64_t block_end = count - i > U16_BLOCK ? i + U16_BLOCK : count;
+        __m256i sum0 = _mm256_setzero_si256();
+        __m256i sum1 = _mm256_setzero_si256();
+        for (; i + 32 <= block_end; i += 32) {
+            sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_xor_si256(_mm256_loadu_si256((__m256i*)&data[i]), bias), ones));
+            sum1 = _mm256_add_epi32(sum1, _mm256_madd_epi16(_mm256_xor_si256(_mm256_loadu_si256((__m256i*)&data[i + 16]), bias), ones));
+        }
+        for (; i + 16 <= block_end; i += 16) {
+            sum0 = _mm256_add_epi32(sum0, _mm256_madd_epi16(_mm256_xor_si256(_mm256_loadu_si256((__m256i*)&data[i]), bias), ones));
+        }
+        __m256i narrow_sum = _mm256_add_epi32(sum0, sum1);
+        wide_sum = _mm256_add_epi64(wide_sum, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(narrow_sum)));
+        wide_sum = _mm256_add_epi64(wide_sum, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(narrow_sum, 1)));
+    }
+
+    uint64_t final_sum = reduce_epi64(wide_sum) + 32768 * i;
+    for (; i < count; i++) {
+        final_sum += data[i];
+    }
+    return final_sum;
+}
+
+// Function to sum 32-bit values with AVX2, zero-extending each half vector into 64-bit lanes
+uint64_t __attribute__((target("avx2"))) Simd256U32(uint64_t count, uint64_t* input_data) {
+    const uint32_t* data = (const uint32_t*)input_data;
+    __m256i sum0 = _mm256_setzero_si256();
+    __m256i sum1 = _mm256_setzero_si256();
+    __m256i sum2 = _mm256_setzero_si256();
+    __m256i sum3 = _mm256_setzero_si256();
+    uint64_t i;
+    for (i = 0; i + 16 <= count; i += 16) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)&data[i])));
+        sum1 = _mm256_add_epi64(sum1, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)&data[i + 4])));
+        sum2 = _mm256_add_epi64(sum2, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)&data[i + 8])));
+        sum3 = _mm256_add_epi64(sum3, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)&data[i + 12])));
+    }
+    for (; i + 4 <= count; i += 4) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i*)&data[i])));
+    }
+
+    uint64_t final_sum = reduce_epi64(_mm256_add_epi64(_mm256_add_epi64(sum0, sum1), _mm256_add_epi64(sum2, sum3)));
+    for (; i < count; i++) {
+        final_sum += data[i];
+    }
+    return final_sum;
+}
+
+// Function to sum floats with AVX2, widening every four floats into double lanes
+uint64_t __attribute__((target("avx2"))) Simd256F32(uint64_t count, uint64_t* input_data) {
+    const float* data = (const float*)input_data;
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    __m256d sum2 = _mm256_setzero_pd();
+    __m256d sum3 = _mm256_setzero_pd();
+    uint64_t i;
+    for (i = 0; i + 16 <= count; i += 16) {
+        sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm_loadu_ps(&data[i])));
+        sum1 = _mm256_add_pd(sum1, _mm256_cvtps_pd(_mm_loadu_ps(&data[i + 4])));
+        sum2 = _mm256_add_pd(sum2, _mm256_cvtps_pd(_mm_loadu_ps(&data[i + 8])));
+        sum3 = _mm256_add_pd(sum3, _mm256_cvtps_pd(_mm_loadu_ps(&data[i + 12])));
+    }
+    for (; i + 4 <= count; i += 4) {
+        sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm_loadu_ps(&data[i])));
+    }
+
+    double final_sum = reduce_pd(_mm256_add_pd(_mm256_add_pd(sum0, sum1), _mm256_add_pd(sum2, sum3)));
+    for (; i < count; i++) {
+        final_sum += data[i];
+    }
+    return double_bits(final_sum);
+}
+
+// Function to sum doubles with AVX2 and 4 independent accumulators
+uint64_t __attribute__((target("avx2"))) Simd256F64(uint64_t count, uint64_t* input_data) {
+    const double* data = (const double*)input_data;
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    __m256d sum2 = _mm256_setzero_pd();
+    __m256d sum3 = _mm256_setzero_pd();
+    uint64_t i;
+    for (i = 0; i + 16 <= count; i += 16) {
+        sum0 = _mm256_add_pd(sum0, _mm256_loadu_pd(&data[i]));
+        sum1 = _mm256_add_pd(sum1, _mm256_loadu_pd(&data[i + 4]));
+        sum2 = _mm256_add_pd(sum2, _mm256_loadu_pd(&data[i + 8]));
+        sum3 = _mm256_add_pd(sum3, _mm256_loadu_pd(&data[i + 12]));
+    }
+    for (; i + 4 <= count; i += 4) {
+        sum0 = _mm256_add_pd(sum0, _mm256_loadu_pd(&data[i]));
+    }
+
+    double final_sum = reduce_pd(_mm256_add_pd(_mm256_add_pd(sum0, sum1), _mm256_add_pd(sum2, sum3)));
+    for (; i < count; i++) {
+        final_sum += data[i];
+    }
+    return double_bits(final_sum);
+}
+
+#define PAIRWISE_BASE 128  // Elements summed sequentially at the leaves of the pairwise tree
+#define FP_BLOCK 1024  // Elements per block of the fixed-order kernels
+#define FP_LANES 16  // Interleaved partial sums per block; element i of a block goes to lane i % FP_LANES
+
+// Generates the float reduction family for TYPE:
+//   Pairwise<SUFFIX>      recursive halving down to PAIRWISE_BASE, error grows with log n
+//   Kahan<SUFFIX>         compensated sum, the correction is lost when an element outweighs the sum
+//   Neumaier<SUFFIX>      compensated sum that also handles elements larger than the running sum
+//   BlockedScalar<SUFFIX> the fixed-order reference: FP_LANES interleaved lanes per FP_BLOCK block,
+//                         a fixed lane tree, and a fixed pairwise tree over block sums. Every kernel
+//                         that follows this order returns the same bits for any SIMD width or thread count
+#define DEFINE_FLOAT_REDUCTIONS(SUFFIX, TYPE, ABS)                                               \
+TYPE pairwise_sum##SUFFIX(const TYPE* data, uint64_t count) {                                   \
+    if (count <= PAIRWISE_BASE) {                                                               \
+        TYPE total_sum = 0;                                                                     \
+        for (uint64_t i = 0; i < count; i++) {                                                  \
+            total_sum += data[i];                                                               \
+        }                                                                                       \
+        return total_sum;                                                                       \
+    }                                                                                           \
+    uint64_t half = count / 2;                                                                  \
+    return pairwise_sum##SUFFIX(data, half) + pairwise_sum##SUFFIX(data + half, count - half);  \
+}                                                                                               \
+                                                                                                \
+uint64_t Pairwise##SUFFIX(uint64_t count, uint64_t* input_data) {                              \
+    return double_bits(pairwise_sum##SUFFIX((const TYPE*)input_data, count));                  \
+}                                                                                               \
+                                                                                                \
+uint64_t Kahan##SUFFIX(uint64_t count, uint64_t* input_data) {                                 \
+    const TYPE* data = (const TYPE*)input_data;                                                 \
+    TYPE total_sum = 0, compensation = 0;                                                       \
+    for (uint64_t i = 0; i < count; i++) {                                                      \
+        TYPE value = data[i] - compensation;                                                    \
+        TYPE next = total_sum + value;                                                          \
+        compensation = (next - total_sum) - value;                                              \
+        total_sum = next;                                                                       \
+    }                                                                                           \
+    return double_bits(total_sum);                                                              \
+}                                                                                               \
+                                                                                                \
+uint64_t Neumaier##SUFFIX(uint64_t count, uint64_t* input_data) {                              \
+    const TYPE* data = (const TYPE*)input_data;                                                 \
+    TYPE total_sum = 0, compensation = 0;                                                       \
+    for (uint64_t i = 0; i < count; i++) {                                                      \
+        TYPE next = total_sum + data[i];                                                        \
+        if (ABS(total_sum) >= ABS(data[i])) {                                                   \
+            compensation += (total_sum - next) + data[i];                                       \
+        } else {                                                                                \
+            compensation += (data[i] - next) + total_sum;                                       \
+        }                                                                                       \
+        total_sum = next;                                                                       \
+    }                                                                                           \
+    return double_bits(total_sum + compensation);                                               \
+}                                                                                               \
+                                                                                                \
+static inline TYPE reduce_lanes##SUFFIX(TYPE* lanes) {                                          \
+    for (int width = FP_LANES / 2; width > 0; width /= 2) {                                     \
+        for (int k = 0; k < width; k++) {                                                       \
+            lanes[k] += lanes[k + width];                                                       \
+        }                                                                                       \
+    }                                                                                           \
+    return lanes[0];                                                                            \
+}                                                                                               \
+                                                                                                \
+static inline TYPE block_sum##SUFFIX(const TYPE* data, uint64_t count) {                        \
+    TYPE lanes[FP_LANES] = {0};                                                                 \
+    for (uint64_t i = 0; i < count; i++) {                                                      \
+        lanes[i % FP_LANES] += data[i];                                                         \
+    }                                                                                           \
+    return reduce_lanes##SUFFIX(lanes);                                                         \
+}                                                                                               \
+                                                                                                \
+/* Binary counter over block sums: merging equal-sized neighbours and folding the rest from   \
+   the right builds the tree that splits n blocks at the largest power of two below n */       \
+typedef struct {                                                                                \
+    TYPE sums[64];                                                                              \
+    uint64_t blocks[64];                                                                        \
+    int depth;                                                                                  \
+} block_tree##SUFFIX;                                                                           \
+                                                                                                \
+static inline void block_tree_push##SUFFIX(block_tree##SUFFIX* tree, TYPE sum) {                \
+    uint64_t blocks = 1;                                                                        \
+    while (tree->depth > 0 && tree->blocks[tree->depth - 1] == blocks) {                        \
+        sum = tree->sums[--tree->depth] + sum;                                                  \
+        blocks *= 2;                                                                            \
+    }                                                                                           \
+    tree->sums[tree->depth] = sum;                                                              \
+    tree->blocks[tree->depth++] = blocks;                                                       \
+}                                                                                               \
+                                                                                                \
+static inline TYPE block_tree_total##SUFFIX(const block_tree##SUFFIX* tree) {                   \
+    if (tree->depth == 0) {                                                                     \
+        return 0;                                                                               \
+    }                                                                                           \
+    TYPE total_sum = tree->sums[tree->depth - 1];                                               \
+    for (int k = tree->depth - 2; k >= 0; k--) {                                                \
+        total_sum = tree->sums[k] + total_sum;                                                  \
+    }                                                                                           \
+    return total_sum;                                                                           \
+}                                                                                               \
+                                                                                                \
+uint64_t BlockedScalar##SUFFIX(uint64_t count, uint64_t* input_data) {                         \
+    const TYPE* data = (const TYPE*)input_data;                                                 \
+    block_tree##SUFFIX tree = {.depth = 0};                                                     \
+    for (uint64_t b = 0; b < count; b += FP_BLOCK) {                                            \
+        block_tree_push##SUFFIX(&tree, block_sum##SUFFIX(data + b, count - b < FP_BLOCK ? count - b : FP_BLOCK)); \
+    }                                                                                           \
+    return double_bits(block_tree_total##SUFFIX(&tree));                                        \
+}
+
+DEFINE_FLOAT_REDUCTIONS(F32, float, fabsf)
+DEFINE_FLOAT_REDUCTIONS(F64, double, fabs)
+
+// Function to sum one fixed-order block of doubles with AVX2: four vectors hold the sixteen lanes
+static inline __attribute__((target("avx2"))) double block_sum_simd256F64(const double* data, uint64_t count) {
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    __m256d sum2 = _mm256_setzero_pd();
+    __m256d sum3 = _mm256_setzero_pd();
+    uint64_t i;
+    for (i = 0; i + FP_LANES <= count; i += FP_LANES) {
+        sum0 = _mm256_add_pd(sum0, _mm256_loadu_pd(&data[i]));
+        sum1 = _mm256_add_pd(sum1, _mm256_loadu_pd(&data[i + 4]));
+        sum2 = _mm256_add_pd(sum2, _mm256_loadu_pd(&data[i + 8]));
+        sum3 = _mm256_add_pd(sum3, _mm256_loadu_pd(&data[i + 12]));
+    }
+    double lanes[FP_LANES];
+    _mm256_storeu_pd(&lanes[0], sum0);
+    _mm256_storeu_pd(&lanes[4], sum1);
+    _mm256_storeu_pd(&lanes[8], sum2);
+    _mm256_storeu_pd(&lanes[12], sum3);
+    for (; i < count; i++) {
+        lanes[i % FP_LANES] += data[i];
+    }
+    return reduce_lanesF64(lanes);
+}
+
+// Function to sum one fixed-order block of floats with AVX2: two vectors hold the sixteen lanes
+static inline __attribute__((target("avx2"))) float block_sum_simd256F32(const float* data, uint64_t count) {
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    uint64_t i;
+    for (i = 0; i + FP_LANES <= count; i += FP_LANES) {
+        sum0 = _mm256_add_ps(sum0, _mm256_loadu_ps(&data[i]));
+        sum1 = _mm256_add_ps(sum1, _mm256_loadu_ps(&data[i + 8]));
+    }
+    float lanes[FP_LANES];
+    _mm256_storeu_ps(&lanes[0], sum0);
+    _mm256_storeu_ps(&lanes[8], sum1);
+    for (; i < count; i++) {
+        lanes[i % FP_LANES] += data[i];
+    }
+    return reduce_lanesF32(lanes);
+}
+
+// Generates BlockedSimd256<SUFFIX>, bitwise identical to BlockedScalar<SUFFIX>
+#define DEFINE_BLOCKED_SIMD256(SUFFIX, TYPE)                                                       \
+uint64_t __attribute__((target("avx2"))) BlockedSimd256##SUFFIX(uint64_t count, uint64_t* input_data) { \
+    const TYPE* data = (const TYPE*)input_data;                                                     \
+    block_tree##SUFFIX tree = {.depth = 0};                                                         \
+    for (uint64_t b = 0; b < count; b += FP_BLOCK) {                                                \
+        block_tree_push##SUFFIX(&tree, block_sum_simd256##SUFFIX(data + b, count - b < FP_BLOCK ? count - b : FP_BLOCK)); \
+    }                                                                                               \
+    return double_bits(block_tree_total##SUFFIX(&tree));                                            \
+}
+
+DEFINE_BLOCKED_SIMD256(F32, float)
+DEFINE_BLOCKED_SIMD256(F64, double)
+
+// Function to sum one chunk with AVX2, four loads per iteration
+uint64_t __attribute__((target("avx2"))) Unroll4Simd256Chunk(uint64_t count, uint64_t* input_data) {
+    __m256i total_sum = _mm256_setzero_si256();
+    uint64_t i;
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m256i data1 = _mm256_loadu_si256((__m256i*)&input_data[i]);
+        __m256i data2 = _mm256_loadu_si256((__m256i*)&input_data[i + 4]);
+        __m256i data3 = _mm256_loadu_si256((__m256i*)&input_data[i + 8]);
+        __m256i data4 = _mm256_loadu_si256((__m256i*)&input_data[i + 12]);
+
+        total_sum = _mm256_add_epi64(total_sum, data1);
+        total_sum = _mm256_add_epi64(total_sum, data2);
+        total_sum = _mm256_add_epi64(total_sum, data3);
+        total_sum = _mm256_add_epi64(total_sum, data4);
+    }
+    uint64_t result[4];
+    _mm256_storeu_si256((__m256i*)result, total_sum);
+    uint64_t final_sum = result[0] + result[1] + result[2] + result[3];
+
+    for (; i < count; i++) {
+        final_sum += input_data[i];
+    }
+    return final_sum;
+}
+
+parallel_kernel parallel_unroll4_scalar = {Unroll4Scalar, 0};
+parallel_kernel parallel_unroll4_simd256 = {Unroll4Simd256Chunk, 0};
+
+worker_pool pool;
+
+int numa_mode = 0;  // Set by --numa: workers are spread over the nodes and first-touch their own slice
+int num_numa_nodes = 0;
+int numa_node_ids[MAX_NUMA_NODES];  // sysfs node number of each detected node
+int num_numa_cpus = 0;
+int numa_cpus[MAX_THREADS];  // Pool slot -> CPU, interleaved across nodes
+int numa_cpu_node[MAX_THREADS];  // Pool slot -> index into numa_node_ids
+int num_placement_cpus = 0;  // Set by --scaling while it runs one SMT placement
+int placement_cpus[MAX_THREADS];  // Pool slot -> CPU for that placement
+
+// Function to pin the calling thread to the n-th CPU of the process affinity mask, to the n-th
+// slot of the node-interleaved CPU list in NUMA mode, or of the placement --scaling is measuring
+void pin_to_cpu(int n) {
+    cpu_set_t allowed, target;
+    if (num_placement_cpus > 0 || (numa_mode && num_numa_cpus > 0)) {
+        CPU_ZERO(&target);
+        CPU_SET(num_placement_cpus > 0 ? placement_cpus[n % num_placement_cpus] : numa_cpus[n % num_numa_cpus], &target);
+        pthread_setaffinity_np(pthread_self(), sizeof(target), &target);
+        return;
+    }
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return;
+    }
+    n %= CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && n-- == 0) {
+            CPU_ZERO(&target);
+            CPU_SET(cpu, &target);
+            pthread_setaffinity_np(pthread_self(), sizeof(target), &target);
+            return;
+        }
+    }
+}
+
+void* worker_main(void* arg) {
+    int index = (int)(intptr_t)arg;
+    thread_task* task = &pool.tasks[index];
+    uint64_t seen = 0;
+
+    pin_to_cpu(index);
+    for (;;) {
+        int spins = 0;
+        uint64_t current;
+        while ((current = atomic_load_explicit(&pool.generation, memory_order_acquire)) == seen) {
+            spin_wait(&spins);
+        }
+        seen = current;
+        if (atomic_load_explicit(&pool.shutdown, memory_order_relaxed)) {
+            return NULL;
+        }
+        uint64_t start = read_tsc_begin();
+        task->partial_sum = task->chunk_func(task->count, task->input_data);
+        task->cycles = read_tsc_end() - start;
+        atomic_fetch_sub_explicit(&pool.pending, 1, memory_order_release);
+    }
+}
+
+// Function to start num_threads - 1 pinned workers, the calling thread acts as worker 0 and is
+// pinned to slot 0 only when pin_caller is set, since its affinity belongs to whoever owns it
+void pool_init(int pin_caller) {
+    pool.num_workers = num_threads;
+    pool.pin_caller = pin_caller;
+    atomic_init(&pool.generation, 0);
+    atomic_init(&pool.pending, 0);
+    atomic_init(&pool.shutdown, 0);
+
+    if (pin_caller) {
+        pin_to_cpu(0);
+    }
+    for (int t = 1; t < pool.num_workers; t++) {
+        if (pthread_create(&pool.threads[t], NULL, worker_main, (void*)(intptr_t)t) != 0) {
+            fprintf(stderr, "Error: Failed to create worker thread %d\n", t);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void pool_shutdown(void) {
+    atomic_store_explicit(&pool.shutdown, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool.generation, 1, memory_order_release);
+    for (int t = 1; t < pool.num_workers; t++) {
+        pthread_join(pool.threads[t], NULL);
+    }
+    pool.num_workers = 0;  // pool_run and the parallel kernels stay on the calling thread until the next pool_init
+    atomic_store_explicit(&pool.shutdown, 0, memory_order_relaxed);
+}
+
+// Function to restart the pool with a different number of workers, pinned by the current placement
+void pool_resize(int workers) {
+    pool_shutdown();
+    num_threads = workers;
+    pool_init(pool.pin_caller);
+}
+
+// Function to split count elements of elem_size bytes into one chunk per worker, chunks rounded
+// up to a multiple of align elements, and sum the partial results; worker t always gets the t-th chunk.
+// Without running workers the calling thread does the whole range as worker 0
+uint64_t pool_run(uint64_t (*chunk_func)(uint64_t, uint64_t*), uint64_t count, uint64_t* input_data, size_t elem_size,
+                  uint64_t align) {
+    if (pool.num_workers <= 1) {
+        thread_task* own = &pool.tasks[0];
+        own->chunk_func = chunk_func;
+        own->count = count;
+        own->input_data = input_data;
+        uint64_t own_start = read_tsc_begin();
+        uint64_t final_sum = chunk_func(count, input_data);
+        own->cycles = read_tsc_end() - own_start;
+        return final_sum;
+    }
+    uint64_t chunk_size = (count / pool.num_workers + align - 1) / align * align;
+
+    uint64_t start = 0;
+    for (int t = 0; t < pool.num_workers; t++) {
+        uint64_t end = (t == pool.num_workers - 1 || start + chunk_size > count) ? count : start + chunk_size;
+        pool.tasks[t].chunk_func = chunk_func;
+        pool.tasks[t].count = end - start;
+        pool.tasks[t].input_data = (uint64_t*)((uint8_t*)input_data + start * elem_size);
+        start = end;
+    }
+
+    // Start barrier: publish the tasks, then release the workers with one generation bump
+    atomic_store_explicit(&pool.pending, pool.num_workers - 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool.generation, 1, memory_order_release);
+
+    thread_task* own = &pool.tasks[0];
+    uint64_t own_start = read_tsc_begin();
+    uint64_t final_sum = own->chunk_func(own->count, own->input_data);
+    own->cycles = read_tsc_end() - own_start;
+
+    // Finish barrier: wait until every worker has published its partial sum
+    int spins = 0;
+    while (atomic_load_explicit(&pool.pending, memory_order_acquire) != 0) {
+        spin_wait(&spins);
+    }
+    for (int t = 1; t < pool.num_workers; t++) {
+        final_sum += pool.tasks[t].partial_sum;
+    }
+    return final_sum;
+}
+
+// Function to sum with the parallel kernel, or serially below its crossover size
+uint64_t parallel_sum(parallel_kernel* kernel, uint64_t count, uint64_t* input_data) {
+    if (pool.num_workers <= 1 || count < kernel->serial_crossover) {
+        return kernel->chunk_func(count, input_data);
+    }
+    // Round chunks up to whole cache lines so neighbouring threads never read the same line
+    return pool_run(kernel->chunk_func, count, input_data, sizeof(uint64_t), CACHE_LINE_SIZE / sizeof(uint64_t));
+}
+
+// Function to perform multithreaded addition, each thread runs the unrolled scalar loop
+uint64_t ParallelUnroll4Scalar(uint64_t count, uint64_t* input_data) {
+    return parallel_sum(&parallel_unroll4_scalar, count, input_data);
+}
+
+// Function to perform multithreaded addition, each thread runs the unrolled AVX2 loop
+uint64_t ParallelUnroll4Simd256(uint64_t count, uint64_t* input_data) {
+    return parallel_sum(&parallel_unroll4_simd256, count, input_data);
+}
+
+// Generates ParallelBlocked<SUFFIX>: workers write the sums of whole FP_BLOCK blocks into a shared
+// array and the caller folds them with the same block tree, so the bits match BlockedScalar<SUFFIX>
+// whatever the thread count
+#define DEFINE_PARALLEL_BLOCKED(SUFFIX, TYPE)                                                      \
+static TYPE* block_sums##SUFFIX = NULL;                                                             \
+static uint64_t block_sums_capacity##SUFFIX = 0;                                                    \
+static const TYPE* blocked_base##SUFFIX = NULL;  /* Start of the input, to index block_sums */      \
+                                                                                                    \
+uint64_t __attribute__((target("avx2"))) BlockSums##SUFFIX##Chunk(uint64_t count, uint64_t* input_data) { \
+    const TYPE* data = (const TYPE*)input_data;                                                     \
+    TYPE* sums = block_sums##SUFFIX + (data - blocked_base##SUFFIX) / FP_BLOCK;                     \
+    for (uint64_t b = 0; b < count; b += FP_BLOCK) {                                                \
+        *sums++ = block_sum_simd256##SUFFIX(data + b, count - b < FP_BLOCK ? count - b : FP_BLOCK); \
+    }                                                                                               \
+    return 0;                                                                                       \
+}                                                                                                   \
+                                                                                                    \
+uint64_t ParallelBlocked##SUFFIX(uint64_t count, uint64_t* input_data) {                           \
+    if (pool.num_workers <= 1) {  /* No workers to share with: same blocks and tree, one thread */  \
+        return BlockedSimd256##SUFFIX(count, input_data);                                           \
+    }                                                                                               \
+    uint64_t num_blocks = (count + FP_BLOCK - 1) / FP_BLOCK;                                        \
+    if (num_blocks > block_sums_capacity##SUFFIX) {                                                 \
+        free(block_sums##SUFFIX);                                                                   \
+        block_sums##SUFFIX = malloc(num_blocks * sizeof(TYPE));                                     \
+        if (block_sums##SUFFIX == NULL) {                                                           \
+            fprintf(stderr, "Error: Memory allocation failed for %" PRIu64 " block sums\n", num_blocks); \
+            exit(EXIT_FAILURE);                                                                     \
+        }                                                                                           \
+        block_sums_capacity##SUFFIX = num_blocks;                                                   \
+    }                                                                                               \
+    blocked_base##SUFFIX = (const TYPE*)input_data;                                                 \
+    pool_run(BlockSums##SUFFIX##Chunk, count, input_data, sizeof(TYPE), FP_BLOCK);                  \
+    block_tree##SUFFIX tree = {.depth = 0};                                                         \
+    for (uint64_t b = 0; b < num_blocks; b++) {                                                     \
+        block_tree_push##SUFFIX(&tree, block_sums##SUFFIX[b]);                                      \
+    }                                                                                               \
+    return double_bits(block_tree_total##SUFFIX(&tree));                                            \
+}
+
+DEFINE_PARALLEL_BLOCKED(F32, float)
+DEFINE_PARALLEL_BLOCKED(F64, double)
+
+// Function to copy the next group of spans, padding a short last group with empty spans
+static inline uint64_t batch_group(const sum_span* spans, uint64_t num_spans, uint64_t s, sum_span* group, uint64_t* common) {
+    uint64_t n = num_spans - s < BATCH_GROUP ? num_spans - s : BATCH_GROUP;
+    *common = UINT64_MAX;
+    for (uint64_t k = 0; k < BATCH_GROUP; k++) {
+        group[k] = k < n ? spans[s + k] : (sum_span){spans[s].data, 0};
+        *common = group[k].count < *common ? group[k].count : *common;
+    }
+    return n;
+}
+
+void BatchUnroll4Scalar(const sum_span* spans, uint64_t num_spans, uint64_t* results) {
+    for (uint64_t s = 0; s < num_spans; s += BATCH_GROUP) {
+        sum_span g[BATCH_GROUP];
+        uint64_t common;
+        uint64_t n = batch_group(spans, num_spans, s, g, &common);
+        uint64_t sums[BATCH_GROUP] = {0, 0, 0, 0};
+        for (uint64_t i = 0; i < common; i++) {
+            sums[0] += g[0].data[i];
+            sums[1] += g[1].data[i];
+            sums[2] += g[2].data[i];
+            sums[3] += g[3].data[i];
+        }
+        for (uint64_t k = 0; k < n; k++) {
+            for (uint64_t i = common; i < g[k].count; i++) {
+                sums[k] += g[k].data[i];
+            }
+            results[s + k] = sums[k];
+        }
+    }
+}
+
+// Function to reduce four vectors at once into the vector of their horizontal sums
+static inline __attribute__((target("avx2"))) __m256i reduce4_epi64(__m256i a, __m256i b, __m256i c, __m256i d) {
+    __m256i ab = _mm256_add_epi64(_mm256_unpacklo_epi64(a, b), _mm256_unpackhi_epi64(a, b));
+    __m256i cd = _mm256_add_epi64(_mm256_unpacklo_epi64(c, d), _mm256_unpackhi_epi64(c, d));
+    return _mm256_add_epi64(_mm256_permute2x128_si256(ab, cd, 0x20), _mm256_permute2x128_si256(ab, cd, 0x31));
+}
+
+void __attribute__((target("avx2"))) BatchSimd256x4(const sum_span* spans, uint64_t num_spans, uint64_t* results) {
+    for (uint64_t s = 0; s < num_spans; s += BATCH_GROUP) {
+        sum_span g[BATCH_GROUP];
+        uint64_t common;
+        uint64_t n = batch_group(spans, num_spans, s, g, &common);
+        __m256i sums[BATCH_GROUP];
+        __m256i sum0 = _mm256_setzero_si256();
+        __m256i sum1 = _mm256_setzero_si256();
+        __m256i sum2 = _mm256_setzero_si256();
+        __m256i sum3 = _mm256_setzero_si256();
+        uint64_t i;
+        for (i = 0; i + 4 <= common; i += 4) {
+            sum0 = _mm256_add_epi64(sum0, _mm256_loadu_si256((__m256i*)&g[0].data[i]));
+            sum1 = _mm256_add_epi64(sum1, _mm256_loadu_si256((__m256i*)&g[1].data[i]));
+            sum2 = _mm256_add_epi64(sum2, _mm256_loadu_si256((__m256i*)&g[2].data[i]));
+            sum3 = _mm256_add_epi64(sum3, _mm256_loadu_si256((__m256i*)&g[3].data[i]));
+        }
+        sums[0] = sum0, sums[1] = sum1, sums[2] = sum2, sums[3] = sum3;
+
+        // Arrays longer than the shortest one in the group continue on their own
+        uint64_t tails[BATCH_GROUP];
+        for (uint64_t k = 0; k < BATCH_GROUP; k++) {
+            uint64_t j;
+            for (j = i; j + 4 <= g[k].count; j += 4) {
+                sums[k] = _mm256_add_epi64(sums[k], _mm256_loadu_si256((__m256i*)&g[k].data[j]));
+            }
+            tails[k] = 0;
+            for (; j < g[k].count; j++) {
+                tails[k] += g[k].data[j];
+            }
+        }
+        uint64_t totals[BATCH_GROUP];
+        _mm256_storeu_si256((__m256i*)totals, reduce4_epi64(sums[0], sums[1], sums[2], sums[3]));
+        for (uint64_t k = 0; k < n; k++) {
+            results[s + k] = totals[k] + tails[k];
+        }
+    }
+}
+
+// Function to sum groups of four arrays with AVX-512, each array ends with one masked load
+void __attribute__((target("avx512f"))) BatchSimd512x4(const sum_span* spans, uint64_t num_spans, uint64_t* results) {
+    for (uint64_t s = 0; s < num_spans; s += BATCH_GROUP) {
+        sum_span g[BATCH_GROUP];
+        uint64_t common;
+        uint64_t n = batch_group(spans, num_spans, s, g, &common);
+        __m512i sums[BATCH_GROUP];
+        __m512i sum0 = _mm512_setzero_si512();
+        __m512i sum1 = _mm512_setzero_si512();
+        __m512i sum2 = _mm512_setzero_si512();
+        __m512i sum3 = _mm512_setzero_si512();
+        uint64_t i;
+        for (i = 0; i + 8 <= common; i += 8) {
+            sum0 = _mm512_add_epi64(sum0, _mm512_loadu_si512(&g[0].data[i]));
+            sum1 = _mm512_add_epi64(sum1, _mm512_loadu_si512(&g[1].data[i]));
+            sum2 = _mm512_add_epi64(sum2, _mm512_loadu_si512(&g[2].data[i]));
+            sum3 = _mm512_add_epi64(sum3, _mm512_loadu_si512(&g[3].data[i]));
+        }
+        sums[0] = sum0, sums[1] = sum1, sums[2] = sum2, sums[3] = sum3;
+
+        for (uint64_t k = 0; k < n; k++) {
+            uint64_t j;
+            for (j = i; j + 8 <= g[k].count; j += 8) {
+                sums[k] = _mm512_add_epi64(sums[k], _mm512_loadu_si512(&g[k].data[j]));
+            }
+            __mmask8 tail_mask = (__mmask8)((1u << (g[k].count - j)) - 1);
+            sums[k] = _mm512_add_epi64(sums[k], _mm512_maskz_loadu_epi64(tail_mask, &g[k].data[j]));
+            results[s + k] = _mm512_reduce_add_epi64(sums[k]);
+        }
+    }
+}
+
+#define AGG_BLOCK 1024  // Elements between checks that every value fit in 32 bits, squared in 64-bit lanes
+
+static inline void aggregate_init(aggregate_stats* stats, uint64_t count) {
+    *stats = (aggregate_stats){.min = UINT64_MAX, .count = count};
+}
+
+static inline __attribute__((always_inline)) void aggregate_scalar(uint64_t count, const uint64_t* input_data, aggregate_stats* stats, int flags) {
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t x = input_data[i];
+        if (flags & AGG_SUM) {
+            stats->sum += x;
+        }
+        if (flags & AGG_MIN) {
+            stats->min = x < stats->min ? x : stats->min;
+        }
+        if (flags & AGG_MAX) {
+            stats->max = x > stats->max ? x : stats->max;
+        }
+        if (flags & AGG_SQUARES) {
+            stats->sum_squares += (unsigned __int128)x * x;
+        }
+    }
+}
+
+// Function to compute the aggregates with AVX2. There is no unsigned 64-bit compare, so min and max
+// run on values biased by the sign bit. vpmuludq squares the low 32 bits exactly; when a block turns
+// out to hold a value of 2^32 or more its squares are redone with 64x64-bit scalar multiplies
+static inline __attribute__((always_inline, target("avx2"))) void aggregate_simd256(uint64_t count, const uint64_t* input_data,
+                                                                                     aggregate_stats* stats, int flags) {
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    __m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+    __m256i min = _mm256_set1_epi64x(INT64_MAX), max = bias;
+    uint64_t i = 0;
+    while (i + 8 <= count) {
+        uint64_t end = i + AGG_BLOCK <= count ? i + AGG_BLOCK : count & ~7ull;
+        __m256i square_low = bias, square_high = _mm256_setzero_si256(), high_bits = _mm256_setzero_si256();
+        for (uint64_t j = i; j < end; j += 8) {
+            __m256i x0 = _mm256_loadu_si256((__m256i*)&input_data[j]);
+            __m256i x1 = _mm256_loadu_si256((__m256i*)&input_data[j + 4]);
+            if (flags & AGG_SUM) {
+                sum0 = _mm256_add_epi64(sum0, x0);
+                sum1 = _mm256_add_epi64(sum1, x1);
+            }
+            if (flags & (AGG_MIN | AGG_MAX)) {
+                __m256i b0 = _mm256_xor_si256(x0, bias), b1 = _mm256_xor_si256(x1, bias);
+                if (flags & AGG_MIN) {
+                    min = _mm256_blendv_epi8(min, b0, _mm256_cmpgt_epi64(min, b0));
+                    min = _mm256_blendv_epi8(min, b1, _mm256_cmpgt_epi64(min, b1));
+                }
+                if (flags & AGG_MAX) {
+                    max = _mm256_blendv_epi8(max, b0, _mm256_cmpgt_epi64(b0, max));
+                    max = _mm256_blendv_epi8(max, b1, _mm256_cmpgt_epi64(b1, max));
+                }
+            }
+            if (flags & AGG_SQUARES) {
+                high_bits = _mm256_or_si256(high_bits, _mm256_or_si256(x0, x1));
+                add_carry256(&square_low, &square_high, _mm256_mul_epu32(x0, x0));
+                add_carry256(&square_low, &square_high, _mm256_mul_epu32(x1, x1));
+            }
+        }
+        if (flags & AGG_SQUARES) {
+            if (_mm256_testz_si256(high_bits, _mm256_set1_epi64x((int64_t)0xffffffff00000000ull))) {
+                uint64_t low_words[4], high_words[4];
+                _mm256_storeu_si256((__m256i*)low_words, _mm256_xor_si256(square_low, bias));
+                _mm256_storeu_si256((__m256i*)high_words, square_high);
+                for (int lane = 0; lane < 4; lane++) {
+                    stats->sum_squares += ((unsigned __int128)high_words[lane] << 64) | low_words[lane];
+                }
+            } else {
+                aggregate_scalar(end - i, &input_data[i], stats, AGG_SQUARES);
+            }
+        }
+        i = end;
+    }
+
+    uint64_t lanes[4];
+    if (flags & AGG_SUM) {
+        stats->sum += reduce_epi64(_mm256_add_epi64(sum0, sum1));
+    }
+    if (flags & AGG_MIN) {
+        _mm256_storeu_si256((__m256i*)lanes, _mm256_xor_si256(min, bias));
+        for (int lane = 0; lane < 4; lane++) {
+            stats->min = lanes[lane] < stats->min ? lanes[lane] : stats->min;
+        }
+    }
+    if (flags & AGG_MAX) {
+        _mm256_storeu_si256((__m256i*)lanes, _mm256_xor_si256(max, bias));
+        for (int lane = 0; lane < 4; lane++) {
+            stats->max = lanes[lane] > stats->max ? lanes[lane] : stats->max;
+        }
+    }
+    aggregate_scalar(count - i, &input_data[i], stats, flags);
+}
+
+// Function to compute the aggregates with AVX-512, which has unsigned min and max and a masked tail
+static inline __attribute__((always_inline, target("avx512f"))) void aggregate_simd512(uint64_t count, const uint64_t* input_data,
+                                                                                       aggregate_stats* stats, int flags) {
+    const __m512i high_mask = _mm512_set1_epi64((int64_t)0xffffffff00000000ull);
+    __m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512();
+    __m512i min = _mm512_set1_epi64(-1), max = _mm512_setzero_si512();
+    uint64_t i = 0;
+    while (i < count) {
+        uint64_t end = i + AGG_BLOCK <= count ? i + AGG_BLOCK : count;
+        __m512i square_low = _mm512_setzero_si512(), square_high = _mm512_setzero_si512();
+        __mmask8 wide = 0;
+        for (uint64_t j = i; j < end; j += 16) {
+            // Lanes past the end load as zero and are left out of min by the masks
+            __mmask8 mask0 = end - j >= 8 ? 0xff : (__mmask8)((1u << (end - j)) - 1);
+            __mmask8 mask1 = end - j >= 16 ? 0xff : end - j > 8 ? (__mmask8)((1u << (end - j - 8)) - 1) : 0;
+            __m512i x0 = _mm512_maskz_loadu_epi64(mask0, &input_data[j]);
+            __m512i x1 = _mm512_maskz_loadu_epi64(mask1, &input_data[j + 8]);
+            if (flags & AGG_SUM) {
+                sum0 = _mm512_add_epi64(sum0, x0);
+                sum1 = _mm512_add_epi64(sum1, x1);
+            }
+            if (flags & AGG_MIN) {
+                min = _mm512_mask_min_epu64(min, mask0, min, x0);
+                min = _mm512_mask_min_epu64(min, mask1, min, x1);
+            }
+            if (flags & AGG_MAX) {
+                max = _mm512_max_epu64(max, _mm512_max_epu64(x0, x1));
+            }
+            if (flags & AGG_SQUARES) {
+                wide |= _mm512_test_epi64_mask(_mm512_or_si512(x0, x1), high_mask);
+                add_carry512(&square_low, &square_high, _mm512_mul_epu32(x0, x0));
+                add_carry512(&square_low, &square_high, _mm512_mul_epu32(x1, x1));
+            }
+        }
+        if (flags & AGG_SQUARES) {
+            if (wide == 0) {
+                uint64_t low_words[8], high_words[8];
+                _mm512_storeu_si512(low_words, square_low);
+                _mm512_storeu_si512(high_words, square_high);
+                for (int lane = 0; lane < 8; lane++) {
+                    stats->sum_squares += ((unsigned __int128)high_words[lane] << 64) | low_words[lane];
+                }
+            } else {
+                aggregate_scalar(end - i, &input_data[i], stats, AGG_SQUARES);
+            }
+        }
+        i = end;
+    }
+
+    if (flags & AGG_SUM) {
+        stats->sum += _mm512_reduce_add_epi64(_mm512_add_epi64(sum0, sum1));
+    }
+    if (flags & AGG_MIN) {
+        uint64_t lane_min = _mm512_reduce_min_epu64(min);
+        stats->min = lane_min < stats->min ? lane_min : stats->min;
+    }
+    if (flags & AGG_MAX) {
+        uint64_t lane_max = _mm512_reduce_max_epu64(max);
+        stats->max = lane_max > stats->max ? lane_max : stats->max;
+    }
+}
+
+// Function to generate the fused kernel of one ISA and its one-pass-per-aggregate counterpart
+#define DEFINE_AGGREGATE(SUFFIX, BODY, TARGET)                                                                    \
+void TARGET Aggregate##SUFFIX(uint64_t count, const uint64_t* input_data, aggregate_stats* stats) {              \
+    aggregate_init(stats, count);                                                                                 \
+    BODY(count, input_data, stats, AGG_ALL);                                                                      \
+}                                                                                                                 \
+                                                                                                                  \
+void TARGET SeparatePasses##SUFFIX(uint64_t count, const uint64_t* input_data, aggregate_stats* stats) {         \
+    aggregate_init(stats, count);                                                                                 \
+    BODY(count, input_data, stats, AGG_SUM);                                                                      \
+    BODY(count, input_data, stats, AGG_MIN);                                                                      \
+    BODY(count, input_data, stats, AGG_MAX);                                                                      \
+    BODY(count, input_data, stats, AGG_SQUARES);                                                                  \
+}
+
+DEFINE_AGGREGATE(Scalar, aggregate_scalar, )
+DEFINE_AGGREGATE(Simd256, aggregate_simd256, __attribute__((target("avx2"))))
+DEFINE_AGGREGATE(Simd512, aggregate_simd512, __attribute__((target("avx512f"))))
+
+// Filtered sums: SUM(x) WHERE lo <= x < hi. All variants test the range with one unsigned compare,
+// x - lo < width, where filter_width makes the width of an empty or inverted range zero so it
+// matches nothing
+static inline uint64_t filter_width(uint64_t lo, uint64_t hi) {
+    return hi > lo ? hi - lo : 0;
+}
+
+// Function to sum the matching elements behind a branch, the empty asm keeps the compiler from
+// turning it into a select so mispredictions stay visible
+uint64_t FilterBranchyScalar(uint64_t count, uint64_t* input_data, uint64_t lo, uint64_t hi) {
+    uint64_t total_sum = 0;
+    uint64_t width = filter_width(lo, hi);
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t x = input_data[i];
+        if (x - lo < width) {
+            __asm__ volatile("");
+            total_sum += x;
+        }
+    }
+    return total_sum;
+}
+
+// Function to sum the matching elements by and-ing each with an all-ones or all-zeros mask
+uint64_t FilterBranchlessScalar(uint64_t count, uint64_t* input_data, uint64_t lo, uint64_t hi) {
+    uint64_t total_sum = 0;
+    uint64_t width = filter_width(lo, hi);
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t x = input_data[i];
+        total_sum += x & -(uint64_t)(x - lo < width);
+    }
+    return total_sum;
+}
+
+// Function to filter with AVX2: the compare is signed, so both sides are biased by the sign bit,
+// and the compare mask is and-ed into the values before the add
+uint64_t __attribute__((target("avx2"))) FilterSimd256x4(uint64_t count, uint64_t* input_data, uint64_t lo, uint64_t hi) {
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i low = _mm256_set1_epi64x((int64_t)lo);
+    const __m256i width = _mm256_xor_si256(_mm256_set1_epi64x((int64_t)filter_width(lo, hi)), bias);
+    __m256i sums[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+    uint64_t i;
+    for (i = 0; i + 16 <= count; i += 16) {
+        for (int k = 0; k < 4; k++) {
+            __m256i x = _mm256_loadu_si256((__m256i*)&input_data[i + 4 * k]);
+            __m256i match = _mm256_cmpgt_epi64(width, _mm256_xor_si256(_mm256_sub_epi64(x, low), bias));
+            sums[k] = _mm256_add_epi64(sums[k], _mm256_and_si256(x, match));
+        }
+    }
+    uint64_t final_sum = reduce_epi64(_mm256_add_epi64(_mm256_add_epi64(sums[0], sums[1]), _mm256_add_epi64(sums[2], sums[3])));
+    uint64_t width_scalar = filter_width(lo, hi);
+    for (; i < count; i++) {
+        final_sum += input_data[i] & -(uint64_t)(input_data[i] - lo < width_scalar);
+    }
+    return final_sum;
+}
+
+// Function to filter with AVX-512: the unsigned compare writes a mask register that drives a masked
+// add, and the tail is one more masked load
+uint64_t __attribute__((target("avx512f"))) FilterSimd512x4(uint64_t count, uint64_t* input_data, uint64_t lo, uint64_t hi) {
+    const __m512i low = _mm512_set1_epi64((int64_t)lo);
+    const __m512i width = _mm512_set1_epi64((int64_t)filter_width(lo, hi));
+    __m512i sums[4] = {_mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512()};
+    uint64_t i;
+    for (i = 0; i + 32 <= count; i += 32) {
+        for (int k = 0; k < 4; k++) {
+            __m512i x = _mm512_loadu_si512(&input_data[i + 8 * k]);
+            sums[k] = _mm512_mask_add_epi64(sums[k], _mm512_cmplt_epu64_mask(_mm512_sub_epi64(x, low), width), sums[k], x);
+        }
+    }
+    for (; i < count; i += 8) {
+        __mmask8 load = count - i >= 8 ? 0xff : (__mmask8)((1u << (count - i)) - 1);
+        __m512i x = _mm512_maskz_loadu_epi64(load, &input_data[i]);
+        sums[0] = _mm512_mask_add_epi64(sums[0], load & _mm512_cmplt_epu64_mask(_mm512_sub_epi64(x, low), width), sums[0], x);
+    }
+    return _mm512_reduce_add_epi64(_mm512_add_epi64(_mm512_add_epi64(sums[0], sums[1]), _mm512_add_epi64(sums[2], sums[3])));
+}
+
+// Compressed input. Both encodings cut the input into PACK_BLOCK-element blocks, store each block's
+// values relative to a frame of reference in the fewest bits that hold them, and leave the last
+// count % PACK_BLOCK elements raw. The packed values are bit-sliced: plane b holds bit b of every
+// value, one bit per element in PACK_WORDS words, so the kernels sum a block from popcounts of its
+// planes without unpacking a single value.
+//   PACK_FOR blocks:   base (the block minimum), width, width planes of value - base
+//   PACK_DELTA blocks: first value, smallest delta (signed), width, width planes of delta - smallest,
+//                      where element 0 has no delta and packs as zero
+// With x[k] = first + d[1] + ... + d[k], the block sums to 128 * first + sum over k of (128 - k) d[k],
+// so the delta kernels weight each bit by 128 - k, using the popcounts of the plane under the masks
+// that select the elements whose index has bit j set.
+static const uint64_t index_bit_masks[6] = {
+    0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+    0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull,
+};
+
+// Function to return the sum of k * bit k over the 64 bits of a plane word
+static inline uint64_t index_weighted_popcount(uint64_t word) {
+    uint64_t total = 0;
+    for (int j = 0; j < 6; j++) {
+        total += (uint64_t)__builtin_popcountll(word & index_bit_masks[j]) << j;
+    }
+    return total;
+}
+
+uint64_t PackedForScalar(uint64_t count, uint64_t* input_data) {
+    const uint64_t* block = input_data;
+    uint64_t total_sum = 0;
+    for (uint64_t n = count / PACK_BLOCK; n > 0; n--) {
+        uint64_t width = block[1];
+        const uint64_t* planes = block + 2;
+        total_sum += PACK_BLOCK * block[0];
+        for (uint64_t b = 0; b < width; b++) {
+            total_sum += (uint64_t)(__builtin_popcountll(planes[2 * b]) + __builtin_popcountll(planes[2 * b + 1])) << b;
+        }
+        block = planes + PACK_WORDS * width;
+    }
+    for (uint64_t i = 0; i < count % PACK_BLOCK; i++) {
+        total_sum += block[i];
+    }
+    return total_sum;
+}
+
+uint64_t PackedDeltaScalar(uint64_t count, uint64_t* input_data) {
+    const uint64_t* block = input_data;
+    uint64_t total_sum = 0;
+    for (uint64_t n = count / PACK_BLOCK; n > 0; n--) {
+        uint64_t width = block[2];
+        const uint64_t* planes = block + 3;
+        total_sum += PACK_BLOCK * block[0] + (PACK_BLOCK * (PACK_BLOCK - 1) / 2) * block[1];
+        for (uint64_t b = 0; b < width; b++) {
+            uint64_t low = planes[2 * b], high = planes[2 * b + 1];
+            uint64_t weighted = ((uint64_t)__builtin_popcountll(low) << 7) + ((uint64_t)__builtin_popcountll(high) << 6) -
+                                index_weighted_popcount(low) - index_weighted_popcount(high);
+            total_sum += weighted << b;
+        }
+        block = planes + PACK_WORDS * width;
+    }
+    for (uint64_t i = 0; i < count % PACK_BLOCK; i++) {
+        total_sum += block[i];
+    }
+    return total_sum;
+}
+
+// Function to count the bits of each 64-bit lane with AVX2: a nibble lookup through vpshufb, then
+// psadbw to add the byte counts of each lane
+static inline __attribute__((target("avx2"))) __m256i popcount256(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+    __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_nibbles)),
+                                     _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles)));
+    return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+// Function to weight the popcounts of two planes (four words) by 128 - k with AVX2
+static inline __attribute__((target("avx2"))) __m256i delta_weights256(__m256i planes) {
+    __m256i weighted = _mm256_sllv_epi64(popcount256(planes), _mm256_setr_epi64x(7, 6, 7, 6));
+    for (int j = 0; j < 6; j++) {
+        __m256i masked = _mm256_and_si256(planes, _mm256_set1_epi64x((int64_t)index_bit_masks[j]));
+        weighted = _mm256_sub_epi64(weighted, _mm256_slli_epi64(popcount256(masked), j));
+    }
+    return weighted;
+}
+
+// Function to sum bit-packed FOR blocks with AVX2, two planes per vector; each lane's popcount is
+// shifted by its plane's bit position, an odd last plane is loaded into the low half
+uint64_t __attribute__((target("avx2"))) PackedForSimd256(uint64_t count, uint64_t* input_data) {
+    const uint64_t* block = input_data;
+    const __m256i last_plane = _mm256_setr_epi64x(-1, -1, 0, 0);
+    __m256i sum = _mm256_setzero_si256();
+    uint64_t total_sum = 0;
+    for (uint64_t n = count / PACK_BLOCK; n > 0; n--) {
+        uint64_t width = block[1];
+        const uint64_t* planes = block + 2;
+        total_sum += PACK_BLOCK * block[0];
+        __m256i shift = _mm256_setr_epi64x(0, 0, 1, 1);
+        uint64_t b;
+        for (b = 0; b + 2 <= width; b += 2) {
+            sum = _mm256_add_epi64(sum, _mm256_sllv_epi64(popcount256(_mm256_loadu_si256((__m256i*)&planes[2 * b])), shift));
+            shift = _mm256_add_epi64(shift, _mm256_set1_epi64x(2));
+        }
+        if (b < width) {
+            __m256i plane = _mm256_maskload_epi64((const long long*)&planes[2 * b], last_plane);
+            sum = _mm256_add_epi64(sum, _mm256_sllv_epi64(popcount256(plane), shift));
+        }
+        block = planes + PACK_WORDS * width;
+    }
+    total_sum += reduce_epi64(sum);
+    for (uint64_t i = 0; i < count % PACK_BLOCK; i++) {
+        total_sum += block[i];
+    }
+    return total_sum;
+}
+
+uint64_t __attribute__((target("avx2"))) PackedDeltaSimd256(uint64_t count, uint64_t* input_data) {
+    const uint64_t* block = input_data;
+    const __m256i last_plane = _mm256_setr_epi64x(-1, -1, 0, 0);
+    __m256i sum = _mm256_setzero_si256();
+    uint64_t total_sum = 0;
+    for (uint64_t n = count / PACK_BLOCK; n > 0; n--) {
+        uint64_t width = block[2];
+        const uint64_t* planes = block + 3;
+        total_sum += PACK_BLOCK * block[0] + (PACK_BLOCK * (PACK_BLOCK - 1) / 2) * block[1];
+        __m256i shift = _mm256_setr_epi64x(0, 0, 1, 1);
+        uint64_t b;
+        for (b = 0; b + 2 <= width; b += 2) {
+            sum = _mm256_add_epi64(sum, _mm256_sllv_epi64(delta_weights256(_mm256_loadu_si256((__m256i*)&planes[2 * b])), shift));
+            shift = _mm256_add_epi64(shift, _mm256_set1_epi64x(2));
+        }
+        if (b < width) {
+            __m256i plane = _mm256_maskload_epi64((const long long*)&planes[2 * b], last_plane);
+            sum = _mm256_add_epi64(sum, _mm256_sllv_epi64(delta_weights256(plane), shift));
+        }
+        block = planes + PACK_WORDS * width;
+    }
+    total_sum += reduce_epi64(sum);
+    for (uint64_t i = 0; i < count % PACK_BLOCK; i++) {
+        total_sum += block[i];
+    }
+    return total_sum;
+}
+
+// Function to sum bit-packed FOR blocks with AVX-512 VPOPCNTQ, four planes per vector and a masked
+// load for the last ones
+uint64_t __attribute__((target("avx512f,avx512vpopcntdq"))) PackedForSimd512(uint64_t count, uint64_t* input_data) {
+    const uint64_t* block = input_data;
+    __m512i sum = _mm512_setzero_si512();
+    uint64_t total_sum = 0;
+    for (uint64_t n = count / PACK_BLOCK; n > 0; n--) {
+        uint64_t width = block[1];
+        const uint64_t* planes = block + 2;
+        total_sum += PACK_BLOCK * block[0];
+        __m512i shift = _mm512_setr_epi64(0, 0, 1, 1, 2, 2, 3, 3);
+        for (uint64_t b = 0; b < width; b += 4) {
+            __mmask8 mask = width - b >= 4 ? 0xff : (__mmask8)((1u << (PACK_WORDS * (width - b))) - 1);
+            __m512i counts = _mm512_popcnt_epi64(_mm512_maskz_loadu_epi64(mask, &planes[2 * b]));
+            sum = _mm512_add_epi64(sum, _mm512_sllv_epi64(counts, shift));
+            shift = _mm512_add_epi64(shift, _mm512_set1_epi64(4));
+        }
+        block = planes + PACK_WORDS * width;
+    }
+    total_sum += _mm512_reduce_add_epi64(sum);
+    for (uint64_t i = 0; i < count % PACK_BLOCK; i++) {
+        total_sum += block[i];
+    }
+    return total_sum;
+}
+
+uint64_t __attribute__((target("avx512f,avx512vpopcntdq"))) PackedDeltaSimd512(uint64_t count, uint64_t* input_data) {
+    const uint64_t* block = input_data;
+    const __m512i lane_weights = _mm512_setr_epi64(7, 6, 7, 6, 7, 6, 7, 6);
+    __m512i sum = _mm512_setzero_si512();
+    uint64_t total_sum = 0;
+    for (uint64_t n = count / PACK_BLOCK; n > 0; n--) {
+        uint64_t width = block[2];
+        const uint64_t* planes = block + 3;
+        total_sum += PACK_BLOCK * block[0] + (PACK_BLOCK * (PACK_BLOCK - 1) / 2) * block[1];
+        __m512i shift = _mm512_setr_epi64(0, 0, 1, 1, 2, 2, 3, 3);
+        for (uint64_t b = 0; b < width; b += 4) {
+            __mmask8 mask = width - b >= 4 ? 0xff : (__mmask8)((1u << (PACK_WORDS * (width - b))) - 1);
+            __m512i words = _mm512_maskz_loadu_epi64(mask, &planes[2 * b]);
+            __m512i weighted = _mm512_sllv_epi64(_mm512_popcnt_epi64(words), lane_weights);
+            for (int j = 0; j < 6; j++) {
+                __m512i masked = _mm512_and_si512(words, _mm512_set1_epi64((int64_t)index_bit_masks[j]));
+                weighted = _mm512_sub_epi64(weighted, _mm512_slli_epi64(_mm512_popcnt_epi64(masked), j));
+            }
+            sum = _mm512_add_epi64(sum, _mm512_sllv_epi64(weighted, shift));
+            shift = _mm512_add_epi64(shift, _mm512_set1_epi64(4));
+        }
+        block = planes + PACK_WORDS * width;
+    }
+    total_sum += _mm512_reduce_add_epi64(sum);
+    for (uint64_t i = 0; i < count % PACK_BLOCK; i++) {
+        total_sum += block[i];
+    }
+    return total_sum;
+}
+
+// Function to sum through the public entry point, so the benchmark times the dispatch it ships
+uint64_t SumU64(uint64_t count, uint64_t* input_data) {
+    return sum_u64(input_data, count);
+}
+
+uint32_t cpu_features = 0;  // Bitmask of FEATURE_* supported by this host, set by detect_cpu_features
+int has_clflushopt = 0;  // CPUID.(EAX=7,ECX=0):EBX bit 23, selects the cold-cache flush instruction
+
+kernel_entry kernels[] = {
+    {"SingleScalar", SingleScalar, 0, 0, NULL, ELEM_U64},
+    {"Unroll2Scalar", Unroll2Scalar, 0, 1, NULL, ELEM_U64},
+    {"Unroll4Scalar", Unroll4Scalar, 0, 2, NULL, ELEM_U64},
+    {"Unroll8Scalar", Unroll8Scalar, 0, 3, NULL, ELEM_U64},
+    {"Unroll16Scalar", Unroll16Scalar, 0, 4, NULL, ELEM_U64},
+    {"Simd128", Simd128, FEATURE_SSE2, 5, NULL, ELEM_U64},
+    {"Simd256", Simd256, FEATURE_AVX2, 6, NULL, ELEM_U64},
+    {"Simd256x4", Simd256x4, FEATURE_AVX2, 8, NULL, ELEM_U64},
+    {"Simd256x8", Simd256x8, FEATURE_AVX2, 9, NULL, ELEM_U64},
+    {"Simd256x4Prefetch", Simd256x4Prefetch, FEATURE_AVX2, 8, NULL, ELEM_U64},
+    {"Simd256x4PrefetchNta", Simd256x4PrefetchNta, FEATURE_AVX2, 8, NULL, ELEM_U64},
+    {"Simd256x4StreamLoad", Simd256x4StreamLoad, FEATURE_AVX2, 8, NULL, ELEM_U64},
+    {"Simd512", Simd512, FEATURE_AVX512F, 7, NULL, ELEM_U64},
+    {"Simd512x4", Simd512x4, FEATURE_AVX512F, 10, NULL, ELEM_U64},
+    // The public entry point, whichever of the kernels above it picked plus one indirect call
+    {"SumU64", SumU64, 0, -1, NULL, ELEM_U64},
+    // Checked and saturating sums answer a different question, so best_kernel never prefers them
+    {"Wide128Scalar", Wide128Scalar, 0, -1, NULL, ELEM_U64},
+    {"CheckedScalar", CheckedScalar, 0, -1, NULL, ELEM_U64},
+    {"CheckedSimd256x4", CheckedSimd256x4, FEATURE_AVX2, -1, NULL, ELEM_U64},
+    {"CheckedSimd512x4", CheckedSimd512x4, FEATURE_AVX512F, -1, NULL, ELEM_U64},
+    {"SaturatingScalar", SaturatingScalar, 0, -1, NULL, ELEM_U64},
+    {"SaturatingSimd256x4", SaturatingSimd256x4, FEATURE_AVX2, -1, NULL, ELEM_U64},
+    {"ParallelUnroll4Scalar", ParallelUnroll4Scalar, 0, 11, &parallel_unroll4_scalar, ELEM_U64},
+    {"ParallelUnroll4Simd256", ParallelUnroll4Simd256, FEATURE_AVX2, 12, &parallel_unroll4_simd256, ELEM_U64},
+    // Narrower and floating-point element types, run over a copy of the input in that type.
+    // Pairwise, Kahan and Neumaier trade speed for accuracy; the Blocked kernels share one
+    // summation order and return the same bits for every ISA and thread count
+    {"ScalarU8", ScalarU8, 0, -1, NULL, ELEM_U8},
+    {"Simd256U8", Simd256U8, FEATURE_AVX2, -1, NULL, ELEM_U8},
+    {"ScalarU16", ScalarU16, 0, -1, NULL, ELEM_U16},
+    {"Simd256U16", Simd256U16, FEATURE_AVX2, -1, NULL, ELEM_U16},
+    {"ScalarU32", ScalarU32, 0, -1, NULL, ELEM_U32},
+    {"Simd256U32", Simd256U32, FEATURE_AVX2, -1, NULL, ELEM_U32},
+    {"ScalarF32", ScalarF32, 0, -1, NULL, ELEM_F32},
+    {"Simd256F32", Simd256F32, FEATURE_AVX2, -1, NULL, ELEM_F32},
+    {"PairwiseF32", PairwiseF32, 0, -1, NULL, ELEM_F32},
+    {"KahanF32", KahanF32, 0, -1, NULL, ELEM_F32},
+    {"NeumaierF32", NeumaierF32, 0, -1, NULL, ELEM_F32},
+    {"BlockedScalarF32", BlockedScalarF32, 0, -1, NULL, ELEM_F32},
+    {"BlockedSimd256F32", BlockedSimd256F32, FEATURE_AVX2, -1, NULL, ELEM_F32},
+    {"ParallelBlockedF32", ParallelBlockedF32, FEATURE_AVX2, -1, NULL, ELEM_F32},
+    {"ScalarF64", ScalarF64, 0, -1, NULL, ELEM_F64},
+    {"Simd256F64", Simd256F64, FEATURE_AVX2, -1, NULL, ELEM_F64},
+    {"PairwiseF64", PairwiseF64, 0, -1, NULL, ELEM_F64},
+    {"KahanF64", KahanF64, 0, -1, NULL, ELEM_F64},
+    {"NeumaierF64", NeumaierF64, 0, -1, NULL, ELEM_F64},
+    {"BlockedScalarF64", BlockedScalarF64, 0, -1, NULL, ELEM_F64},
+    {"BlockedSimd256F64", BlockedSimd256F64, FEATURE_AVX2, -1, NULL, ELEM_F64},
+    {"ParallelBlockedF64", ParallelBlockedF64, FEATURE_AVX2, -1, NULL, ELEM_F64},
+};
+
+const int num_kernels = sizeof(kernels) / sizeof(kernels[0]);
+
+const batch_entry batch_kernels[] = {
+    {"BatchUnroll4Scalar", BatchUnroll4Scalar, 0},
+    {"BatchSimd256x4", BatchSimd256x4, FEATURE_AVX2},
+    {"BatchSimd512x4", BatchSimd512x4, FEATURE_AVX512F},
+};
+
+const int num_batch_kernels = sizeof(batch_kernels) / sizeof(batch_kernels[0]);
+
+const aggregate_entry aggregate_kernels[] = {
+    {"Scalar", AggregateScalar, SeparatePassesScalar, 0},
+    {"Simd256", AggregateSimd256, SeparatePassesSimd256, FEATURE_AVX2},
+    {"Simd512", AggregateSimd512, SeparatePassesSimd512, FEATURE_AVX512F},
+};
+
+const int num_aggregate_kernels = sizeof(aggregate_kernels) / sizeof(aggregate_kernels[0]);
+
+// The checked kernels of the main registry with their wide forms, from scalar to widest
+const wide_entry wide_kernels[] = {
+    {Wide128Scalar, Wide128ScalarWide, 0},
+    {CheckedScalar, CheckedScalarWide, 0},
+    {CheckedSimd256x4, CheckedSimd256x4Wide, FEATURE_AVX2},
+    {CheckedSimd512x4, CheckedSimd512x4Wide, FEATURE_AVX512F},
+};
+
+const int num_wide_kernels = sizeof(wide_kernels) / sizeof(wide_kernels[0]);
+
+// Filtered sum kernels, run by --filter over inputs of controlled selectivity
+const filter_entry filter_kernels[] = {
+    {"FilterBranchyScalar", FilterBranchyScalar, 0},
+    {"FilterBranchlessScalar", FilterBranchlessScalar, 0},
+    {"FilterSimd256x4", FilterSimd256x4, FEATURE_AVX2},
+    {"FilterSimd512x4", FilterSimd512x4, FEATURE_AVX512F},
+};
+
+const int num_filter_kernels = sizeof(filter_kernels) / sizeof(filter_kernels[0]);
+
+packed_entry packed_kernels[] = {
+    {{"PackedForScalar", PackedForScalar, 0, -1, NULL, ELEM_U64}, PACK_FOR},
+    {{"PackedForSimd256", PackedForSimd256, FEATURE_AVX2, -1, NULL, ELEM_U64}, PACK_FOR},
+    {{"PackedForSimd512", PackedForSimd512, FEATURE_AVX512F | FEATURE_AVX512VPOPCNTDQ, -1, NULL, ELEM_U64}, PACK_FOR},
+    {{"PackedDeltaScalar", PackedDeltaScalar, 0, -1, NULL, ELEM_U64}, PACK_DELTA},
+    {{"PackedDeltaSimd256", PackedDeltaSimd256, FEATURE_AVX2, -1, NULL, ELEM_U64}, PACK_DELTA},
+    {{"PackedDeltaSimd512", PackedDeltaSimd512, FEATURE_AVX512F | FEATURE_AVX512VPOPCNTDQ, -1, NULL, ELEM_U64}, PACK_DELTA},
+};
+
+const int num_packed_kernels = sizeof(packed_kernels) / sizeof(packed_kernels[0]);
+
+void detect_cpu_features(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        cpu_features |= FEATURE_SSE2;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        cpu_features |= FEATURE_AVX2;
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        cpu_features |= FEATURE_AVX512F;
+    }
+    if (__builtin_cpu_supports("avx512vpopcntdq")) {
+        cpu_features |= FEATURE_AVX512VPOPCNTDQ;
+    }
+
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        has_clflushopt = (ebx >> 23) & 1;
+    }
+}
+
+int kernel_supported(const kernel_entry* kernel) {
+    return (kernel->required_features & ~cpu_features) == 0;
+}
+
+// Function to return the wide form of a registry kernel, NULL unless it is one of the checked kernels
+const wide_entry* wide_kernel(uint64_t (*func)(uint64_t, uint64_t*)) {
+    for (int k = 0; k < num_wide_kernels; k++) {
+        if (wide_kernels[k].func == func) {
+            return &wide_kernels[k];
+        }
+    }
+    return NULL;
+}
+
+// Function to return the fastest kernel this host can run for the given element count
+const kernel_entry* best_kernel(uint64_t size) {
+    const kernel_entry* best = NULL;
+    for (int k = 0; k < num_kernels; k++) {
+        const kernel_entry* kernel = &kernels[k];
+        if (!kernel_supported(kernel) || kernel->elem_type != ELEM_U64 || (kernel->parallel != NULL && size < kernel->parallel->serial_crossover)) {
+            continue;
+        }
+        if (best == NULL || kernel->priority > best->priority) {
+            best = kernel;
+        }
+    }
+    return best;
+}
+
+// Function to write the inclusive running sum of one block into out, four lanes at a time
+static __attribute__((target("avx2"))) uint64_t prefix_block_simd256(const uint64_t* data, uint64_t* out, uint64_t count) {
+    __m256i carry = _mm256_setzero_si256();
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // In-register scan: add the vector shifted by one lane, then the result shifted by two
+        __m256i x = _mm256_loadu_si256((const __m256i*)(data + i));
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, 0x90), _mm256_setzero_si256(), 0x03));
+        x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, 0x40), _mm256_setzero_si256(), 0x0f));
+        x = _mm256_add_epi64(x, carry);
+        _mm256_storeu_si256((__m256i*)(out + i), x);
+        carry = _mm256_permute4x64_epi64(x, 0xff);
+    }
+    uint64_t running = i > 0 ? out[i - 1] : 0;
+    for (; i < count; i++) {
+        running += data[i];
+        out[i] = running;
+    }
+    return running;
+}
+
+static uint64_t prefix_block_scalar(const uint64_t* data, uint64_t* out, uint64_t count) {
+    uint64_t running = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        running += data[i];
+        out[i] = running;
+    }
+    return running;
+}
+
+static uint64_t (*prefix_block)(const uint64_t*, uint64_t*, uint64_t) = prefix_block_scalar;
+
+// Function to rescan the dirty blocks and redo block_prefix from the first of them
+void prefix_refresh(prefix_index* index) {
+    if (index->first_dirty == index->num_blocks) {
+        return;
+    }
+    for (uint64_t w = index->first_dirty / 64; w < (index->num_blocks + 63) / 64; w++) {
+        for (uint64_t bits = index->dirty[w]; bits != 0; bits &= bits - 1) {
+            uint64_t block = w * 64 + __builtin_ctzll(bits);
+            if (block >= index->num_blocks) {
+                break;  // prefix_rebuild sets the padding bits of the last word too
+            }
+            uint64_t start = block * PREFIX_BLOCK;
+            uint64_t n = index->count - start < PREFIX_BLOCK ? index->count - start : PREFIX_BLOCK;
+            index->block_sums[block] = prefix_block(index->data + start, index->local + start, n);
+        }
+        index->dirty[w] = 0;
+    }
+    for (uint64_t b = index->first_dirty; b < index->num_blocks; b++) {
+        index->block_prefix[b + 1] = index->block_prefix[b] + index->block_sums[b];
+    }
+    index->first_dirty = index->num_blocks;
+}
+
+// Function to mark every block dirty and rescan them all into the existing tables
+void prefix_rebuild(prefix_index* index) {
+    memset(index->dirty, 0xff, (index->num_blocks + 63) / 64 * sizeof(uint64_t));
+    index->first_dirty = 0;
+    prefix_refresh(index);
+}
+
+// Function to build the index over count elements of data, allocating its tables
+void prefix_build(prefix_index* index, uint64_t* data, uint64_t count) {
+    index->data = data;
+    index->count = count;
+    index->num_blocks = (count + PREFIX_BLOCK - 1) / PREFIX_BLOCK;
+    // One spare entry each, so an empty index still gets real allocations rather than malloc(0)
+    index->local = malloc((count + 1) * sizeof(uint64_t));
+    index->block_sums = malloc((index->num_blocks + 1) * sizeof(uint64_t));
+    index->block_prefix = malloc((index->num_blocks + 1) * sizeof(uint64_t));
+    index->dirty = malloc(((index->num_blocks + 63) / 64 + 1) * sizeof(uint64_t));
+    if (index->local == NULL || index->block_sums == NULL || index->block_prefix == NULL || index->dirty == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the prefix index\n");
+        exit(EXIT_FAILURE);
+    }
+    index->block_prefix[0] = 0;
+    prefix_rebuild(index);
+}
+
+void prefix_free(prefix_index* index) {
+    free(index->local);
+    free(index->block_sums);
+    free(index->block_prefix);
+    free(index->dirty);
+}
+
+// Function to store value at position i of the indexed buffer, the index catches up on the next query
+void prefix_update(prefix_index* index, uint64_t i, uint64_t value) {
+    uint64_t block = i / PREFIX_BLOCK;
+    index->data[i] = value;
+    index->dirty[block / 64] |= 1ull << (block % 64);
+    index->first_dirty = block < index->first_dirty ? block : index->first_dirty;
+}
+
+// Function to return the sum of data[first..last), refreshing the index first if updates are pending;
+// last is clamped to the indexed count and an empty or inverted range sums to 0
+uint64_t prefix_range_sum(prefix_index* index, uint64_t first, uint64_t last) {
+    if (index->first_dirty != index->num_blocks) {
+        prefix_refresh(index);
+    }
+    last = last < index->count ? last : index->count;
+    if (last <= first) {
+        return 0;
+    }
+    uint64_t high = index->block_prefix[(last - 1) / PREFIX_BLOCK] + index->local[last - 1];
+    uint64_t low = first > 0 ? index->block_prefix[(first - 1) / PREFIX_BLOCK] + index->local[first - 1] : 0;
+    return high - low;
+}
+
+// Function to encode count elements of data into out with the given PACK_* encoding, returns the
+// words written; out needs room for count + 3 * (count / PACK_BLOCK) words, the incompressible case
+uint64_t pack_input(const uint64_t* data, uint64_t count, uint64_t* out, int encoding) {
+    uint64_t* block = out;
+    for (uint64_t n = 0; n < count / PACK_BLOCK; n++) {
+        const uint64_t* x = data + n * PACK_BLOCK;
+        uint64_t values[PACK_BLOCK];
+        uint64_t* planes;
+        if (encoding == PACK_FOR) {
+            uint64_t base = UINT64_MAX;
+            for (int i = 0; i < PACK_BLOCK; i++) {
+                base = x[i] < base ? x[i] : base;
+            }
+            for (int i = 0; i < PACK_BLOCK; i++) {
+                values[i] = x[i] - base;
+            }
+            block[0] = base;
+            planes = block + 2;
+        } else {
+            int64_t smallest = INT64_MAX;
+            for (int i = 1; i < PACK_BLOCK; i++) {
+                int64_t delta = (int64_t)(x[i] - x[i - 1]);
+                smallest = delta < smallest ? delta : smallest;
+            }
+            values[0] = 0;
+            for (int i = 1; i < PACK_BLOCK; i++) {
+                values[i] = x[i] - x[i - 1] - (uint64_t)smallest;
+            }
+            block[0] = x[0];
+            block[1] = (uint64_t)smallest;
+            planes = block + 3;
+        }
+
+        uint64_t bits = 0;
+        for (int i = 0; i < PACK_BLOCK; i++) {
+            bits |= values[i];
+        }
+        uint64_t width = bits == 0 ? 0 : 64 - __builtin_clzll(bits);
+        planes[-1] = width;
+        for (uint64_t b = 0; b < width; b++) {
+            for (int w = 0; w < PACK_WORDS; w++) {
+                uint64_t word = 0;
+                for (int i = 0; i < 64; i++) {
+                    word |= ((values[64 * w + i] >> b) & 1) << i;
+                }
+                planes[PACK_WORDS * b + w] = word;
+            }
+        }
+        block = planes + PACK_WORDS * width;
+    }
+    memcpy(block, data + count / PACK_BLOCK * PACK_BLOCK, count % PACK_BLOCK * sizeof(uint64_t));
+    return block + count % PACK_BLOCK - out;
+}
+
+#define OVERHEAD_RUNS 10000  // Empty calls used to estimate the timer and call overhead
+#define TSC_CALIBRATION_NS 250000000  // Wall-clock window used to calibrate the TSC when CPUID can't report it
+
+uint64_t timer_overhead = 0;  // Cycles of an empty kernel call, subtracted from every sample
+double tsc_hz = 0;  // TSC ticks per second, set once by calibrate_tsc
+const char* tsc_source = "";  // Where tsc_hz came from, for the report
+
+uint64_t __attribute__((noinline)) EmptyKernel(uint64_t count, uint64_t* input_data) {
+    (void)count;
+    (void)input_data;
+    return 0;
+}
+
+// Function to measure the cycles of calling an empty kernel through the timed region
+void measure_timer_overhead(void) {
+    uint64_t min_cycles = UINT64_MAX;
+    for (int run = 0; run < OVERHEAD_RUNS; run++) {
+        uint64_t start = read_tsc_begin();
+        EmptyKernel(0, NULL);
+        uint64_t cycles = read_tsc_end() - start;
+        if (cycles < min_cycles) {
+            min_cycles = cycles;
+        }
+    }
+    timer_overhead = min_cycles;
+}
+
+uint64_t elapsed_ns(const struct timespec* start_time, const struct timespec* end_time) {
+    return (end_time->tv_sec - start_time->tv_sec) * 1000000000 + (end_time->tv_nsec - start_time->tv_nsec);
+}
+
+// Function to determine the TSC frequency once: CPUID leaf 0x15 reports it exactly on recent
+// Intel parts, everything else is calibrated against CLOCK_MONOTONIC_RAW over a long window
+void calibrate_tsc(void) {
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) >= 0x15) {
+        __cpuid_count(0x15, 0, eax, ebx, ecx, edx);
+        // EBX/EAX is the TSC to crystal clock ratio, ECX the crystal frequency in Hz when enumerated
+        if (eax != 0 && ebx != 0 && ecx != 0) {
+            tsc_hz = (double)ecx * ebx / eax;
+            tsc_source = "CPUID leaf 0x15";
+            return;
+        }
+    }
+
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+    uint64_t start = read_tsc_begin();
+    do {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+    } while (elapsed_ns(&start_time, &end_time) < TSC_CALIBRATION_NS);
+    uint64_t end = read_tsc_end();
+
+    tsc_hz = (double)(end - start) / (elapsed_ns(&start_time, &end_time) / 1e9);
+    tsc_source = "calibrated against CLOCK_MONOTONIC_RAW";
+}
+
+// Function to return the TSC frequency, calibrating it on the first call
+double sum_tsc_hz(void) {
+    if (tsc_hz == 0) {
+        calibrate_tsc();
+    }
+    return tsc_hz;
+}
+
+// The TSC reads as functions, for the runners that reach them through an FFI
+uint64_t sum_tsc_begin(void) {
+    return read_tsc_begin();
+}
+
+uint64_t sum_tsc_end(void) {
+    return read_tsc_end();
+}
+
+// Function to look up a kernel of the main registry by name
+const kernel_entry* find_kernel(const char* name) {
+    for (int k = 0; k < num_kernels; k++) {
+        if (strcmp(kernels[k].name, name) == 0) {
+            return &kernels[k];
+        }
+    }
+    return NULL;
+}
+
+// Function to time a u64 kernel the way the benchmark does with a warm cache: the minimum TSC
+// cycles over runs calls, less the overhead of an empty call. Eviction, perf counters and the
+// adaptive run count stay with the benchmark's measure_cycles
+uint64_t sum_measure_cycles(const char* name, const uint64_t* data, size_t count, int runs, uint64_t* result) {
+    const kernel_entry* kernel = find_kernel(name);
+    if (kernel == NULL || kernel->elem_type != ELEM_U64 || !kernel_supported(kernel)) {
+        return 0;
+    }
+    if (timer_overhead == 0) {
+        measure_timer_overhead();
+    }
+    uint64_t min_cycles = UINT64_MAX;
+    for (int run = 0; run < runs; run++) {
+        uint64_t start = read_tsc_begin();
+        uint64_t total_sum = kernel->func(count, (uint64_t*)data);
+        uint64_t cycles = read_tsc_end() - start;
+        cycles = cycles > timer_overhead ? cycles - timer_overhead : 1;
+        min_cycles = cycles < min_cycles ? cycles : min_cycles;
+        if (result != NULL) {
+            *result = total_sum;
+        }
+    }
+    return min_cycles;
+}
+
+// sum_u64 calls through sum_u64_func, which resolve_sum_u64 points at the chosen kernel when the
+// library is loaded. It is a pointer set by a constructor rather than a GNU ifunc because the
+// choice reads the registry, and an ifunc resolver may run before the registry's own relocations
+// have been applied. Until then it leads to sum_u64_first_call, which resolves on the spot, so a
+// call from another library's constructor still works.
+static const kernel_entry* sum_u64_entry = NULL;
+static uint64_t sum_u64_first_call(uint64_t count, uint64_t* input_data);
+static uint64_t (*sum_u64_func)(uint64_t, uint64_t*) = sum_u64_first_call;
+static uint64_t sum_u64_wide_first_call(uint64_t count, uint64_t* input_data, uint64_t* high);
+static uint64_t (*sum_u64_wide_func)(uint64_t, uint64_t*, uint64_t*) = sum_u64_wide_first_call;
+
+// Function to pick the kernels sum_u64, sum_u64_wide and the prefix index use from the host's
+// features. Parallel kernels are left out: they need a running pool and a calibrated crossover,
+// which only the caller can decide on. sum_u64_wide takes the widest checked kernel the host supports
+static void __attribute__((constructor)) resolve_sum_u64(void) {
+    detect_cpu_features();
+    const kernel_entry* best = NULL;
+    for (int k = 0; k < num_kernels; k++) {
+        const kernel_entry* kernel = &kernels[k];
+        if (!kernel_supported(kernel) || kernel->elem_type != ELEM_U64 || kernel->parallel != NULL) {
+            continue;
+        }
+        if (best == NULL || kernel->priority > best->priority) {
+            best = kernel;
+        }
+    }
+    for (int k = 0; k < num_wide_kernels; k++) {
+        if ((wide_kernels[k].required_features & ~cpu_features) == 0) {
+            sum_u64_wide_func = wide_kernels[k].wide;
+        }
+    }
+    if (cpu_features & FEATURE_AVX2) {
+        prefix_block = prefix_block_simd256;
+    }
+    sum_u64_entry = best;
+    sum_u64_func = best->func;
+}
+
+static uint64_t sum_u64_first_call(uint64_t count, uint64_t* input_data) {
+    resolve_sum_u64();
+    return sum_u64_func(count, input_data);
+}
+
+static uint64_t sum_u64_wide_first_call(uint64_t count, uint64_t* input_data, uint64_t* high) {
+    resolve_sum_u64();
+    return sum_u64_wide_func(count, input_data, high);
+}
+
+uint64_t sum_u64(const uint64_t* data, size_t count) {
+    return sum_u64_func(count, (uint64_t*)data);
+}
+
+uint64_t sum_u64_wide(const uint64_t* data, size_t count, uint64_t* high) {
+    return sum_u64_wide_func(count, (uint64_t*)data, high);
+}
+
+const char* sum_u64_kernel(void) {
+    if (sum_u64_entry == NULL) {
+        resolve_sum_u64();
+    }
+    return sum_u64_entry->name;
+}
+
+// Function to release the block sums ParallelBlocked<SUFFIX> grows on demand
+static void __attribute__((destructor)) free_block_sums(void) {
+    free(block_sumsF32);
+    free(block_sumsF64);
+}
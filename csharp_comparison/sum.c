@@ -1,152 +1,2890 @@
+#define _GNU_SOURCE  // For sched_getaffinity and pthread_setaffinity_np
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <inttypes.h> 
 #include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <getopt.h>
+#include <cpuid.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
 #include <tmmintrin.h>
 #include <immintrin.h>
 
-#define NUM_RUNS 100  // Number of times to run each test to find the minimum cycle count
+#include "sum_internal.h"
 
-// You can compile this code using the following command:
-// gcc -O0 -Wno-cpp -o sum sum.c
+#define DEFAULT_RUNS 100  // Number of times to run each test to find the minimum cycle count, see --runs
+#define MAX_SIZES 1024  // Upper bound for the number of test sizes from --sizes or --sweep
+#define MAX_CACHE_LEVELS 8  // Data and unified caches reported by sysfs or CPUID leaf 4
+#define DEFAULT_MAX_RUNS 1000  // Cap on the runs --adaptive may take for one kernel and size
+#define ADAPTIVE_MIN_RUNS 10  // Default --runs in adaptive mode, also the batch between CI checks
+#define BOOTSTRAP_RESAMPLES 500  // Resamples for the bootstrap confidence interval of the median
+#define DEFAULT_THRESHOLD 5.0  // Throughput drop in percent that --baseline reports as a regression
+#define HUGE_PAGE_SIZE (2ull << 20)  // The input arena is aligned to and sized in 2 MiB pages
+#define CALIBRATION_SIZE (1ull << 22)  // Largest element count tried by calibrate_crossover
 
-// Function to perform addition using uint64_t
-uint64_t SingleScalar(uint64_t count, uint64_t* input_data) {
-    uint64_t total_sum = 0;
-    for (uint64_t i = 0; i < count; i++) {
-        total_sum += input_data[i];
+// Build it with the Makefile next to this file; `make` produces libsum.a and libsum.so from
+// libsum.c and one binary per build: sum-O2 links libsum.a, sum-O0, sum-O3 (-O3 -march=native)
+// and sum-pgo (profile-guided -O3 -march=native) compile libsum.c with their own flags.
+// A plain compile works as well:
+// gcc -O0 -Wno-cpp -pthread -o sum sum.c libsum.c -lm
+//
+// The parallel kernels run on a pinned worker pool that uses all online CPUs by default,
+// set SUM_THREADS to override:
+// SUM_THREADS=4 ./sum
+//
+// The Makefile passes the build name and flags so every report row can say which build produced it
+
+#ifndef SUM_BUILD
+#define SUM_BUILD "custom"
+#endif
+
+#ifndef SUM_CFLAGS
+#define SUM_CFLAGS "unknown"
+#endif
+
+// Report format selected by --format; json and csv keep stdout machine-readable and send the
+// informational header to stderr
+enum {
+    FORMAT_TEXT,
+    FORMAT_JSON,
+    FORMAT_CSV,
+};
+
+static int output_format = FORMAT_TEXT;
+static FILE* log_output = NULL;  // stdout for text reports, stderr otherwise
+static int num_runs = DEFAULT_RUNS;  // Runs per kernel and size, set by --runs; the minimum in adaptive mode
+static int max_runs = DEFAULT_MAX_RUNS;  // Upper bound for adaptive mode, set by --max-runs
+static double adaptive_ci_width = 0;  // Target width of the median CI relative to the median, 0 disables --adaptive
+
+// Function to print the names of the features a kernel needs but the host lacks
+void print_missing_features(uint32_t missing) {
+    if (missing & FEATURE_SSE2) {
+        fprintf(log_output, " SSE2");
+    }
+    if (missing & FEATURE_AVX2) {
+        fprintf(log_output, " AVX2");
+    }
+    if (missing & FEATURE_AVX512F) {
+        fprintf(log_output, " AVX-512F");
+    }
+    if (missing & FEATURE_AVX512VPOPCNTDQ) {
+        fprintf(log_output, " AVX-512VPOPCNTDQ");
+    }
+}
+
+// Hardware counters read around every kernel call in --perf mode
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_STALL_CYCLES,
+    PERF_NUM_COUNTERS,
+};
+
+typedef struct {
+    uint64_t values[PERF_NUM_COUNTERS];
+} perf_sample;
+
+static int perf_mode = 0;  // Set by --perf once perf_open succeeded
+static int perf_fds[PERF_NUM_COUNTERS];  // -1 for counters this host or kernel doesn't expose
+
+// Function to open one counter for the calling thread, user space only
+static int perf_open_counter(uint32_t type, uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+// Function to open the counter group led by core cycles; returns 0 when not even cycles are available.
+// Counters follow the calling thread only, so parallel kernels report the dispatching thread's share.
+int perf_open(void) {
+    perf_fds[PERF_CYCLES] = perf_open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (perf_fds[PERF_CYCLES] < 0) {
+        return 0;
     }
-    return total_sum;
+    int leader = perf_fds[PERF_CYCLES];
+    perf_fds[PERF_INSTRUCTIONS] = perf_open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, leader);
+    perf_fds[PERF_L1D_MISSES] = perf_open_counter(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), leader);
+    perf_fds[PERF_LLC_MISSES] = perf_open_counter(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), leader);
+    perf_fds[PERF_STALL_CYCLES] = perf_open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND, leader);
+    return 1;
+}
+
+static inline void perf_start(void) {
+    ioctl(perf_fds[PERF_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf_fds[PERF_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
 }
 
-// Function to perform addition using uint64_t with loop unrolling by 2
-uint64_t Unroll2Scalar(uint64_t count, uint64_t* input_data) {
-    uint64_t total_sum = 0;
-    for (uint64_t i = 0; i < count; i += 2) {
-        total_sum += input_data[i];
-        total_sum += input_data[i + 1];
+static inline void perf_stop(perf_sample* sample) {
+    ioctl(perf_fds[PERF_CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        if (perf_fds[c] < 0 || read(perf_fds[c], &sample->values[c], sizeof(uint64_t)) != sizeof(uint64_t)) {
+            sample->values[c] = UINT64_MAX;
+        }
     }
-    return total_sum;
 }
 
-// Function to perform addition using uint64_t with loop unrolling by 4
-uint64_t Unroll4Scalar(uint64_t count, uint64_t* input_data) {
-    uint64_t total_sum = 0;
-    for (uint64_t i = 0; i < count; i += 4) {
-        total_sum += input_data[i];
-        total_sum += input_data[i + 1];
-        total_sum += input_data[i + 2];
-        total_sum += input_data[i + 3];
+// Cache state every sample starts from, see --warm and --cold
+enum {
+    CACHE_WARM,  // Back-to-back runs over the same buffer, everything that fits stays cached
+    CACHE_COLD_FLUSH,  // clflushopt (or clflush) every line of the input before each run
+    CACHE_COLD_STREAM,  // Read a scratch buffer twice the size of the largest cache before each run
+};
+
+static int cache_mode = CACHE_WARM;
+static uint64_t* scratch_data = NULL;  // Eviction buffer for CACHE_COLD_STREAM
+static uint64_t scratch_count = 0;
+static volatile uint64_t scratch_sink;  // Keeps the eviction reads from being optimized away
+
+void __attribute__((target("clflushopt"))) flush_lines_opt(uint8_t* start, uint8_t* end) {
+    for (uint8_t* line = start; line < end; line += CACHE_LINE_SIZE) {
+        _mm_clflushopt(line);
     }
-    return total_sum;
 }
 
-// Function to perform addition using SIMD with SSE2 for 64-bit integers
-uint64_t __attribute__((target("sse2"))) Simd128(uint64_t count, uint64_t* input_data) {
-    __m128i total_sum = _mm_setzero_si128();
-    uint64_t i;
-    for (i = 0; i + 2 <= count; i += 2) {
-        __m128i data = _mm_loadu_si128((__m128i*)&input_data[i]);
-        total_sum = _mm_add_epi64(total_sum, data);
+void flush_lines(uint8_t* start, uint8_t* end) {
+    for (uint8_t* line = start; line < end; line += CACHE_LINE_SIZE) {
+        _mm_clflush(line);
     }
-    uint64_t result[2];
-    _mm_storeu_si128((__m128i*)result, total_sum);
-    uint64_t final_sum = result[0] + result[1];
+}
 
-    for (; i < count; i++) {
-        final_sum += input_data[i];
+// Function to evict the input from every cache level before a cold sample
+void evict_input(void* input_data, uint64_t bytes) {
+    if (cache_mode == CACHE_COLD_FLUSH) {
+        uint8_t* start = (uint8_t*)((uintptr_t)input_data & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+        uint8_t* end = (uint8_t*)input_data + bytes;
+        if (has_clflushopt) {
+            flush_lines_opt(start, end);
+        } else {
+            flush_lines(start, end);
+        }
+        _mm_mfence();
+    } else if (cache_mode == CACHE_COLD_STREAM) {
+        uint64_t sum = 0;
+        for (uint64_t j = 0; j < scratch_count; j += CACHE_LINE_SIZE / sizeof(uint64_t)) {
+            sum += scratch_data[j];
+        }
+        scratch_sink = sum;
     }
-    return final_sum;
 }
 
-// Function to perform addition using SIMD with AVX2 for 64-bit integers
-uint64_t __attribute__((target("avx2"))) Simd256(uint64_t count, uint64_t* input_data) {
-    __m256i total_sum = _mm256_setzero_si256();
-    uint64_t i;
-    for (i = 0; i + 4 <= count; i += 4) {
-        __m256i data = _mm256_loadu_si256((__m256i*)&input_data[i]);
-        total_sum = _mm256_add_epi64(total_sum, data);
+// Distribution of the per-run cycle counts of one kernel and size
+typedef struct {
+    uint64_t min, median, p90, p99, max;
+    double stddev;
+    uint64_t ci_low, ci_high;  // Bootstrap 95% confidence interval of the median
+    int runs;
+} cycle_stats;
+
+static uint64_t* samples = NULL;  // Every sample of the current measure_cycles call
+static uint64_t* scratch_samples = NULL;  // Sorting and resampling space, same capacity
+static int samples_capacity = 0;
+static uint64_t bootstrap_state = 0x9e3779b97f4a7c15ull;  // Fixed seed so reports are reproducible
+
+static inline uint64_t bootstrap_random(void) {
+    bootstrap_state ^= bootstrap_state << 13;
+    bootstrap_state ^= bootstrap_state >> 7;
+    bootstrap_state ^= bootstrap_state << 17;
+    return bootstrap_state;
+}
+
+int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Function to return the k-th smallest value, partially reordering values (quickselect)
+uint64_t select_kth(uint64_t* values, int count, int k) {
+    int low = 0, high = count - 1;
+    while (low < high) {
+        uint64_t pivot = values[low + (high - low) / 2];
+        int i = low, j = high;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                uint64_t swap = values[i];
+                values[i++] = values[j];
+                values[j--] = swap;
+            }
+        }
+        if (k <= j) {
+            high = j;
+        } else if (k >= i) {
+            low = i;
+        } else {
+            break;
+        }
     }
-    uint64_t result[4];
-    _mm256_storeu_si256((__m256i*)result, total_sum);
-    uint64_t final_sum = result[0] + result[1] + result[2] + result[3];
+    return values[k];
+}
 
-    for (; i < count; i++) {
-        final_sum += input_data[i];
+// Function to compute the percentile bootstrap 95% confidence interval of the median
+void bootstrap_median_ci(const uint64_t* values, int count, uint64_t* low, uint64_t* high) {
+    static uint64_t medians[BOOTSTRAP_RESAMPLES];
+    for (int b = 0; b < BOOTSTRAP_RESAMPLES; b++) {
+        for (int i = 0; i < count; i++) {
+            scratch_samples[i] = values[bootstrap_random() % count];
+        }
+        medians[b] = select_kth(scratch_samples, count, count / 2);
     }
-    return final_sum;
+    qsort(medians, BOOTSTRAP_RESAMPLES, sizeof(uint64_t), compare_u64);
+    *low = medians[BOOTSTRAP_RESAMPLES * 25 / 1000];
+    *high = medians[BOOTSTRAP_RESAMPLES * 975 / 1000 - 1];
+}
+
+// Function to summarize the first count samples; percentiles use the nearest-rank method
+void compute_stats(int count, cycle_stats* stats) {
+    bootstrap_median_ci(samples, count, &stats->ci_low, &stats->ci_high);
+
+    memcpy(scratch_samples, samples, count * sizeof(uint64_t));
+    qsort(scratch_samples, count, sizeof(uint64_t), compare_u64);
+    stats->runs = count;
+    stats->min = scratch_samples[0];
+    stats->median = scratch_samples[count / 2];
+    stats->p90 = scratch_samples[(int)ceil(0.90 * count) - 1];
+    stats->p99 = scratch_samples[(int)ceil(0.99 * count) - 1];
+    stats->max = scratch_samples[count - 1];
+
+    double mean = 0, variance = 0;
+    for (int i = 0; i < count; i++) {
+        mean += scratch_samples[i];
+    }
+    mean /= count;
+    for (int i = 0; i < count; i++) {
+        variance += (scratch_samples[i] - mean) * (scratch_samples[i] - mean);
+    }
+    stats->stddev = count > 1 ? sqrt(variance / (count - 1)) : 0;
 }
 
-// Function to measure CPU cycles and calculate the CPU clock speed
-uint64_t measure_cycles(uint64_t (*func)(uint64_t, uint64_t*), uint64_t* input_data, uint64_t size, double* cpu_clock) {
+// Function to measure a kernel's TSC cycles, returning the minimum over all runs. Without --adaptive
+// it takes num_runs samples; with it, it keeps sampling in batches until the median CI is narrower
+// than adaptive_ci_width or max_runs is reached. perf and stats are optional outputs; in --perf mode
+// the counters of the fastest run are stored in perf. size counts elements of elem_size bytes.
+uint64_t measure_cycles(uint64_t (*func)(uint64_t, uint64_t*), uint64_t* input_data, uint64_t size, size_t elem_size,
+                        perf_sample* perf, cycle_stats* stats) {
     uint64_t min_cycles = UINT64_MAX;
-    struct timespec start_time, end_time;
-
-    for (int run = 0; run < NUM_RUNS; run++) {
-        uint32_t start_low, start_high, end_low, end_high;
-        uint64_t start, end, cycles;
-        
-        clock_gettime(CLOCK_MONOTONIC, &start_time);  // Get start time in nanoseconds
-        asm volatile ("rdtsc" : "=a" (start_low), "=d" (start_high));
-        func(size, input_data);
-        asm volatile ("rdtsc" : "=a" (end_low), "=d" (end_high));
-        clock_gettime(CLOCK_MONOTONIC, &end_time);  // Get end time in nanoseconds
+    int counting = perf_mode && perf != NULL;
+    int adaptive = adaptive_ci_width > 0;
+    int limit = adaptive ? (max_runs > num_runs ? max_runs : num_runs) : num_runs;
+    perf_sample sample;
 
-        start = ((uint64_t)start_high << 32) | start_low;
-        end = ((uint64_t)end_high << 32) | end_low;
-        cycles = end - start;
+    if (samples_capacity < limit) {
+        samples = realloc(samples, limit * sizeof(uint64_t));
+        scratch_samples = realloc(scratch_samples, limit * sizeof(uint64_t));
+        if (samples == NULL || scratch_samples == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for %d samples\n", limit);
+            exit(EXIT_FAILURE);
+        }
+        samples_capacity = limit;
+    }
 
-        uint64_t elapsed_ns = (end_time.tv_sec - start_time.tv_sec) * 1000000000 + (end_time.tv_nsec - start_time.tv_nsec);
-        *cpu_clock = (double)cycles / (elapsed_ns / 1e9);  // Calculate CPU clock in Hz
+    int run;
+    for (run = 0; run < limit; run++) {
+        evict_input(input_data, size * elem_size);
+        if (counting) {
+            perf_start();
+        }
+        uint64_t start = read_tsc_begin();
+        func(size, input_data);
+        uint64_t cycles = read_tsc_end() - start;
+        if (counting) {
+            perf_stop(&sample);
+        }
 
+        cycles = cycles > timer_overhead ? cycles - timer_overhead : 1;
+        samples[run] = cycles;
         if (cycles < min_cycles) {
             min_cycles = cycles;
+            if (counting) {
+                *perf = sample;
+            }
+        }
+
+        int taken = run + 1;
+        if (adaptive && taken >= num_runs && taken % ADAPTIVE_MIN_RUNS == 0) {
+            uint64_t ci_low, ci_high;
+            bootstrap_median_ci(samples, taken, &ci_low, &ci_high);
+            // The bootstrap leaves its last resample in scratch_samples, so take the median of a fresh copy
+            memcpy(scratch_samples, samples, taken * sizeof(uint64_t));
+            if (ci_high - ci_low <= adaptive_ci_width * select_kth(scratch_samples, taken, taken / 2)) {
+                run++;
+                break;
+            }
         }
     }
 
+    if (stats != NULL) {
+        compute_stats(run, stats);
+    }
     return min_cycles;
 }
 
-void run_test(const char* func_name, uint64_t (*func)(uint64_t, uint64_t*), uint64_t* sizes, int num_sizes) {
-    printf("\nRunning tests for function: %s\n", func_name);
-    printf("=======================================================================================================\n");
-    printf("%-20s%-25s%-20s%-20s%-15s\n", "Test Size", "Result", "CPU Cycles", "CPU Clock (GHz)", "Adds per Cycle");
-    printf("-------------------------------------------------------------------------------------------------------\n");
+// One input buffer shared by every kernel and size; each test sums a prefix of it, so the
+// page faults, the init loop and the hugepage setup are paid once per process
+typedef struct {
+    uint64_t* data;
+    uint64_t capacity;  // Elements
+    size_t mapped_bytes;
+    const char* backing;
+    int elem_type;  // ELEM_* the arena currently holds
+    int selectivity;  // input_selectivity the u64 contents were generated for
+} input_arena;
+
+static input_arena arena;
+
+// Selectivity of the generated u64 input for the filtered kernels, set per pass by --filter.
+// A percentage of the elements falls in [FILTER_LO, FILTER_HI) at random positions; the rest
+// lands just below or above the range so both compares matter
+#define SELECTIVITY_NONE -1  // input_data[j] = j
+#define SELECTIVITY_RANDOM -2  // A fresh random percentage for every SELECTIVITY_BLOCK elements
+#define SELECTIVITY_BLOCK 1024
+#define MAX_SELECTIVITIES 16
+#define FILTER_LO (1ull << 20)
+#define FILTER_HI (1ull << 21)
+
+static int input_selectivity = SELECTIVITY_NONE;
+
+// Function to map a 2 MiB aligned arena for count elements without touching its pages,
+// preferring explicit huge pages and falling back to transparent huge pages
+void arena_map(uint64_t count) {
+    size_t bytes = (count * sizeof(uint64_t) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void* data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    arena.backing = "MAP_HUGETLB";
+
+    if (data == MAP_FAILED) {
+        // Over-allocate by one huge page and trim both ends so the arena starts 2 MiB aligned
+        size_t padded = bytes + HUGE_PAGE_SIZE;
+        uint8_t* raw = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            fprintf(stderr, "Error: Memory allocation failed for %" PRIu64 " elements\n", count);
+            exit(EXIT_FAILURE);
+        }
+        uint8_t* aligned = (uint8_t*)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+        if (aligned > raw) {
+            munmap(raw, aligned - raw);
+        }
+        munmap(aligned + bytes, raw + padded - (aligned + bytes));
+        data = aligned;
+        arena.backing = madvise(data, bytes, MADV_HUGEPAGE) == 0 ? "transparent huge pages" : "4 KiB pages";
+    }
+
+    arena.data = data;
+    arena.capacity = count;
+    arena.mapped_bytes = bytes;
+    arena.selectivity = SELECTIVITY_NONE;
+}
+
+// Function to map the arena and fill it with input_data[j] = j from the calling thread
+void arena_init(uint64_t count) {
+    arena_map(count);
+
+    // Writing every element also pre-faults every page before the first measurement
+    for (uint64_t j = 0; j < count; j++) {
+        arena.data[j] = j;
+    }
+    arena.elem_type = ELEM_U64;
+}
+
+// Function to derive a float input from its index: a 20-bit mantissa scaled by 2^-8..2^7. Values
+// are exact in float and double, so both types sum the same numbers, and naive sums round
+// while the __float128 reference of up to 2^80 of them stays exact
+static inline double float_input(uint64_t j) {
+    uint64_t hash = j * 0x9E3779B97F4A7C15ull;
+    return ldexp(1.0 + (double)(hash >> 44) / (1 << 20), (int)((hash >> 40) & 15) - 8);
+}
+
+// Function to generate count u64 elements of which input_selectivity percent fall in
+// [FILTER_LO, FILTER_HI), the range run_filter_test passes to the filtered kernels
+void fill_selective(uint64_t* data, uint64_t count) {
+    uint64_t state = 0x2545f4914f6cdd1dull;
+    uint64_t percent = input_selectivity;
+    for (uint64_t j = 0; j < count; j++) {
+        state ^= state << 13, state ^= state >> 7, state ^= state << 17;
+        if (input_selectivity == SELECTIVITY_RANDOM && j % SELECTIVITY_BLOCK == 0) {
+            percent = (state >> 32) % 101;
+        }
+        uint64_t offset = (state >> 8) % FILTER_LO;
+        if ((state >> 40) % 100 < percent) {
+            data[j] = FILTER_LO + offset % (FILTER_HI - FILTER_LO);
+        } else {
+            data[j] = state & 1 ? offset : FILTER_HI + offset;
+        }
+    }
+}
+
+// Function to refill the arena in elem_type: integers hold input_data[j] = j truncated to the
+// type, floats hold float_input(j), and u64 comes from fill_selective while --filter sets a selectivity
+void arena_fill(int elem_type) {
+    if (arena.elem_type == elem_type && (elem_type != ELEM_U64 || arena.selectivity == input_selectivity)) {
+        return;
+    }
+    uint64_t count = arena.capacity;
+    switch (elem_type) {
+    case ELEM_U8:
+        for (uint64_t j = 0; j < count; j++) {
+            ((uint8_t*)arena.data)[j] = (uint8_t)j;
+        }
+        break;
+    case ELEM_U16:
+        for (uint64_t j = 0; j < count; j++) {
+            ((uint16_t*)arena.data)[j] = (uint16_t)j;
+        }
+        break;
+    case ELEM_U32:
+        for (uint64_t j = 0; j < count; j++) {
+            ((uint32_t*)arena.data)[j] = (uint32_t)j;
+        }
+        break;
+    case ELEM_F32:
+        for (uint64_t j = 0; j < count; j++) {
+            ((float*)arena.data)[j] = (float)float_input(j);
+        }
+        break;
+    case ELEM_F64:
+        for (uint64_t j = 0; j < count; j++) {
+            ((double*)arena.data)[j] = float_input(j);
+        }
+        break;
+    default:
+        if (input_selectivity != SELECTIVITY_NONE) {
+            fill_selective(arena.data, count);
+            break;
+        }
+        for (uint64_t j = 0; j < count; j++) {
+            arena.data[j] = j;
+        }
+        break;
+    }
+    arena.elem_type = elem_type;
+    arena.selectivity = input_selectivity;
+}
+
+// Exact float sums of arena prefixes, computed once per element type and size
+typedef struct {
+    int elem_type;
+    uint64_t size;
+    double exact;
+} reference_sum;
+
+static reference_sum references[2 * MAX_SIZES];
+static int num_references = 0;
+
+// Function to return the exact sum of the first size arena elements, rounded to double; the
+// __float128 accumulator has room for every bit of the float inputs
+double exact_reference(uint64_t size) {
+    for (int r = 0; r < num_references; r++) {
+        if (references[r].elem_type == arena.elem_type && references[r].size == size) {
+            return references[r].exact;
+        }
+    }
+    __float128 total_sum = 0;
+    for (uint64_t j = 0; j < size; j++) {
+        total_sum += arena.elem_type == ELEM_F32 ? ((float*)arena.data)[j] : ((double*)arena.data)[j];
+    }
+    if (num_references < (int)(sizeof(references) / sizeof(references[0]))) {
+        references[num_references++] = (reference_sum){arena.elem_type, size, (double)total_sum};
+    }
+    return (double)total_sum;
+}
+
+void arena_free(void) {
+    munmap(arena.data, arena.mapped_bytes);
+    arena.data = NULL;
+}
+
+// Function to map a file of native-endian uint64_t as the arena, read-only and zero-copy, so every
+// kernel sums the page cache directly; MAP_POPULATE faults the whole file in up front and
+// MADV_SEQUENTIAL lets the kernel read ahead aggressively and drop pages behind the scan
+void arena_map_file(const char* path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open %s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    uint64_t count = (uint64_t)st.st_size / sizeof(uint64_t);
+    if (count == 0) {
+        fprintf(stderr, "Error: %s holds no complete uint64_t element\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map %s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    arena.data = data;
+    arena.capacity = count;
+    arena.mapped_bytes = st.st_size;
+    arena.backing = "file mapping, MAP_POPULATE";
+    arena.elem_type = ELEM_U64;
+    arena.selectivity = SELECTIVITY_NONE;
+}
+
+// Function to find the smallest size at which the pool beats the serial chunk function,
+// doubling from 1024 elements; sizes that never win keep the kernel serial
+void calibrate_crossover(parallel_kernel* kernel, uint64_t (*parallel_func)(uint64_t, uint64_t*)) {
+    const uint64_t max_size = arena.capacity < CALIBRATION_SIZE ? arena.capacity : CALIBRATION_SIZE;
+    uint64_t* input_data = arena.data;
+
+    kernel->serial_crossover = UINT64_MAX;
+    if (pool.num_workers <= 1) {
+        return;
+    }
+
+    for (uint64_t size = 1024; size <= max_size; size *= 2) {
+        uint64_t serial_cycles = measure_cycles(kernel->chunk_func, input_data, size, sizeof(uint64_t), NULL, NULL);
+        kernel->serial_crossover = 0;
+        uint64_t parallel_cycles = measure_cycles(parallel_func, input_data, size, sizeof(uint64_t), NULL, NULL);
+        kernel->serial_crossover = UINT64_MAX;
+        if (parallel_cycles < serial_cycles) {
+            kernel->serial_crossover = size;
+            break;
+        }
+    }
+}
+
+void print_crossover(const char* func_name, parallel_kernel* kernel) {
+    if (kernel->serial_crossover == UINT64_MAX) {
+        fprintf(log_output, "  %-24s always serial (the pool never beat one thread)\n", func_name);
+    } else {
+        fprintf(log_output, "  %-24s serial below %" PRIu64 " elements\n", func_name, kernel->serial_crossover);
+    }
+}
+
+// Data or unified cache level of the host, smallest first
+typedef struct {
+    char name[8];
+    uint64_t size;
+} cache_level;
+
+static cache_level caches[MAX_CACHE_LEVELS];
+static int num_caches = 0;
+
+// Function to read a sysfs attribute of cpu0's cache index into buf, returns 0 if it is missing
+int read_cache_attribute(int index, const char* attribute, char* buf, int buf_size) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/%s", index, attribute);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    int ok = fgets(buf, buf_size, file) != NULL;
+    fclose(file);
+    return ok;
+}
+
+void add_cache_level(int level, int data_only, uint64_t size) {
+    if (num_caches == MAX_CACHE_LEVELS || size == 0) {
+        return;
+    }
+    cache_level* cache = &caches[num_caches++];
+    snprintf(cache->name, sizeof(cache->name), "L%d%s", level, data_only ? "d" : "");
+    cache->size = size;
+}
+
+// Function to detect the data cache sizes from sysfs, falling back to CPUID leaf 4
+void detect_caches(void) {
+    char type[32], level[8], size[32];
+    for (int index = 0; index < 16; index++) {
+        if (!read_cache_attribute(index, "type", type, sizeof(type)) ||
+            !read_cache_attribute(index, "level", level, sizeof(level)) ||
+            !read_cache_attribute(index, "size", size, sizeof(size))) {
+            continue;
+        }
+        if (strncmp(type, "Instruction", 11) == 0) {
+            continue;
+        }
+        char* suffix;
+        uint64_t bytes = strtoull(size, &suffix, 10);
+        bytes <<= *suffix == 'K' ? 10 : *suffix == 'M' ? 20 : *suffix == 'G' ? 30 : 0;
+        add_cache_level(atoi(level), strncmp(type, "Data", 4) == 0, bytes);
+    }
+
+    if (num_caches == 0 && __get_cpuid_max(0, NULL) >= 4) {
+        for (uint32_t subleaf = 0;; subleaf++) {
+            uint32_t eax, ebx, ecx, edx;
+            __cpuid_count(4, subleaf, eax, ebx, ecx, edx);
+            uint32_t cache_type = eax & 0x1f;  // 0 = no more caches, 1 = data, 2 = instruction, 3 = unified
+            if (cache_type == 0) {
+                break;
+            }
+            if (cache_type == 2) {
+                continue;
+            }
+            uint64_t ways = ((ebx >> 22) & 0x3ff) + 1;
+            uint64_t partitions = ((ebx >> 12) & 0x3ff) + 1;
+            uint64_t line_size = (ebx & 0xfff) + 1;
+            uint64_t sets = (uint64_t)ecx + 1;
+            add_cache_level((eax >> 5) & 0x7, cache_type == 1, ways * partitions * line_size * sets);
+        }
+    }
+
+    // Keep the levels sorted by size so cache_for_size can stop at the first fit
+    for (int i = 1; i < num_caches; i++) {
+        for (int j = i; j > 0 && caches[j].size < caches[j - 1].size; j--) {
+            cache_level swap = caches[j];
+            caches[j] = caches[j - 1];
+            caches[j - 1] = swap;
+        }
+    }
+}
+
+// Function to name the smallest cache level a working set of the given size fits in
+const char* cache_for_size(uint64_t bytes) {
+    for (int i = 0; i < num_caches; i++) {
+        if (bytes <= caches[i].size) {
+            return caches[i].name;
+        }
+    }
+    return "DRAM";
+}
+
+// Function to pick the pipeline chunk size: the L2, so a chunk the producer just wrote is still
+// cached when the consumer sums it, rounded down to whole pages for O_DIRECT (1 MiB if undetected)
+uint64_t l2_chunk_bytes(void) {
+    for (int i = 0; i < num_caches; i++) {
+        if (strncmp(caches[i].name, "L2", 2) == 0 && caches[i].size >= 4096) {
+            return caches[i].size & ~4095ull;
+        }
+    }
+    return 1ull << 20;
+}
+
+void format_bytes(uint64_t bytes, char* buf, int buf_size) {
+    if (bytes >= (1ull << 30)) {
+        snprintf(buf, buf_size, "%.1f GiB", bytes / (double)(1ull << 30));
+    } else if (bytes >= (1ull << 20)) {
+        snprintf(buf, buf_size, "%.1f MiB", bytes / (double)(1ull << 20));
+    } else if (bytes >= (1ull << 10)) {
+        snprintf(buf, buf_size, "%.1f KiB", bytes / (double)(1ull << 10));
+    } else {
+        snprintf(buf, buf_size, "%" PRIu64 " B", bytes);
+    }
+}
+
+// Function to format high * 2^64 + low in decimal, printf has no 128-bit conversion
+void format_u128(uint64_t high, uint64_t low, char* buf, int buf_size) {
+    unsigned __int128 value = ((unsigned __int128)high << 64) | low;
+    char digits[40];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + (int)(value % 10));
+        value /= 10;
+    } while (value != 0);
+    int i = 0;
+    for (; i < n && i < buf_size - 1; i++) {
+        buf[i] = digits[n - 1 - i];
+    }
+    buf[i] = '\0';
+}
+
+void print_rule(char c, int width) {
+    for (int i = 0; i < width; i++) {
+        putchar(c);
+    }
+    putchar('\n');
+}
+
+// Function to print a counter column, n/a when the host doesn't expose that counter
+void print_counter(uint64_t value) {
+    if (value == UINT64_MAX) {
+        printf("%-16s", "n/a");
+    } else {
+        printf("%-16" PRIu64, value);
+    }
+}
+
+// One measured kernel and size, kept for the machine-readable output and the baseline comparison
+typedef struct {
+    const char* kernel;
+    uint64_t size;
+    uint64_t result;
+    uint64_t result_high;  // Carry-out word from the checked kernels, zero for everything else
+    int elem_type;  // ELEM_*; float results hold the bits of a double
+    double rel_error;  // |result - exact| / |exact| for float types, NAN otherwise
+    uint64_t bytes;  // Bytes the kernel read when that isn't size elements, e.g. compressed input; 0 otherwise
+    uint64_t cycles;  // Minimum over all runs
+    double adds_per_cycle;
+    cycle_stats stats;
+    perf_sample perf;
+} test_record;
+
+// Function to format a record's result: 128-bit for the checked kernels, a double for float types
+void format_result(const test_record* record, char* buf, int buf_size) {
+    if (element_types[record->elem_type].is_float) {
+        snprintf(buf, buf_size, "%.17g", bits_double(record->result));
+    } else {
+        format_u128(record->result_high, record->result, buf, buf_size);
+    }
+}
+
+static test_record* records = NULL;
+static int num_records = 0;
+static int records_capacity = 0;
+
+void add_record(const test_record* record) {
+    if (num_records == records_capacity) {
+        records_capacity = records_capacity == 0 ? 64 : records_capacity * 2;
+        records = realloc(records, records_capacity * sizeof(test_record));
+        if (records == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for the result records\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    records[num_records++] = *record;
+}
+
+// Host metadata written with every machine-readable report
+typedef struct {
+    char cpu_model[49];
+    const char* build;
+    const char* compiler;
+    const char* cflags;
+    const char* cache_mode;
+} host_info;
+
+static host_info host;
+
+// Function to read the processor brand string from CPUID leaves 0x80000002-0x80000004
+void detect_host(void) {
+    uint32_t words[12] = {0};
+    if (__get_cpuid_max(0x80000000, NULL) >= 0x80000004) {
+        for (uint32_t leaf = 0; leaf < 3; leaf++) {
+            __cpuid(0x80000002 + leaf, words[leaf * 4], words[leaf * 4 + 1], words[leaf * 4 + 2], words[leaf * 4 + 3]);
+        }
+    }
+    memcpy(host.cpu_model, words, sizeof(words));
+    host.cpu_model[48] = '\0';
+
+    // Trim the padding some vendors put around the brand string, and drop characters
+    // that would need quoting in the CSV and JSON output
+    char* start = host.cpu_model;
+    while (*start == ' ') {
+        start++;
+    }
+    memmove(host.cpu_model, start, strlen(start) + 1);
+    for (char* c = host.cpu_model; *c != '\0'; c++) {
+        if (*c == ',' || *c == '"' || *c == '\\') {
+            *c = ' ';
+        }
+    }
+    for (size_t n = strlen(host.cpu_model); n > 0 && host.cpu_model[n - 1] == ' '; n--) {
+        host.cpu_model[n - 1] = '\0';
+    }
+    if (host.cpu_model[0] == '\0') {
+        strcpy(host.cpu_model, "unknown");
+    }
+
+    host.compiler = "gcc " __VERSION__;
+    host.build = SUM_BUILD;
+    host.cflags = SUM_CFLAGS;
+    host.cache_mode = cache_mode == CACHE_WARM ? "warm" : cache_mode == CACHE_COLD_FLUSH ? "cold-flush" : "cold-stream";
+}
+
+// Function to print a perf counter as a JSON value or CSV field, empty or null when unavailable
+void print_machine_counter(uint64_t value) {
+    if (value == UINT64_MAX) {
+        printf(output_format == FORMAT_JSON ? "null" : "");
+    } else {
+        printf("%" PRIu64, value);
+    }
+}
+
+void print_report_header(void) {
+    if (output_format == FORMAT_JSON) {
+        printf("{\"runner\": \"c\", \"host\": {\"cpu_model\": \"%s\", \"tsc_hz\": %.0f, \"compiler\": \"%s\", "
+               "\"cflags\": \"%s\", \"build\": \"%s\", \"threads\": %d, \"cache_mode\": \"%s\"},\n\"results\": [\n",
+               host.cpu_model, tsc_hz, host.compiler, host.cflags, host.build, num_threads, host.cache_mode);
+    } else if (output_format == FORMAT_CSV) {
+        printf("runner,kernel,size,result,time_s,min_cycles,adds_per_cycle,runs,cpu_model,tsc_hz,compiler,cflags,build,"
+               "bytes,cache_level,median_cycles,p90_cycles,p99_cycles,max_cycles,stddev_cycles,ci_low_cycles,ci_high_cycles,"
+               "core_cycles,instructions,l1d_misses,llc_misses,backend_stalls,threads,cache_mode,result_high,elem_type,bytes_per_cycle,rel_error\n");
+    }
+}
+
+void print_report_footer(void) {
+    if (output_format == FORMAT_JSON) {
+        printf("\n]}\n");
+    }
+}
+
+// Function to return the bytes a record's kernel read
+uint64_t record_bytes(const test_record* record) {
+    return record->bytes > 0 ? record->bytes : record->size * element_types[record->elem_type].size;
+}
+
+// Function to print one record as a JSON object on its own line or as a CSV row
+void print_machine_record(const test_record* record) {
+    const cycle_stats* stats = &record->stats;
+    const uint64_t* counters = record->perf.values;
+    const element_type* type = &element_types[record->elem_type];
+    uint64_t bytes = record_bytes(record);
+    char result[48];
+    format_result(record, result, sizeof(result));
+
+    if (output_format == FORMAT_JSON) {
+        printf("%s  {\"runner\": \"c\", \"kernel\": \"%s\", \"size\": %" PRIu64 ", \"result\": %s, "
+               "\"time_s\": %.9f, \"min_cycles\": %" PRIu64 ", \"adds_per_cycle\": %.6f, \"runs\": %d, \"build\": \"%s\", "
+               "\"bytes\": %" PRIu64 ", \"cache_level\": \"%s\", \"median_cycles\": %" PRIu64 ", "
+               "\"p90_cycles\": %" PRIu64 ", \"p99_cycles\": %" PRIu64 ", \"max_cycles\": %" PRIu64 ", "
+               "\"stddev_cycles\": %.1f, \"ci_low_cycles\": %" PRIu64 ", \"ci_high_cycles\": %" PRIu64,
+               num_records > 1 ? ",\n" : "", record->kernel, record->size, result, record->cycles / tsc_hz,
+               record->cycles, record->adds_per_cycle, stats->runs, host.build, bytes, cache_for_size(bytes), stats->median,
+               stats->p90, stats->p99, stats->max, stats->stddev, stats->ci_low, stats->ci_high);
+        const char* names[PERF_NUM_COUNTERS] = {"core_cycles", "instructions", "l1d_misses", "llc_misses", "backend_stalls"};
+        for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+            printf(", \"%s\": ", names[c]);
+            print_machine_counter(perf_mode ? counters[c] : UINT64_MAX);
+        }
+        printf(", \"result_high\": %" PRIu64 ", \"elem_type\": \"%s\", \"bytes_per_cycle\": %.6f, \"rel_error\": ",
+               record->result_high, type->name, (double)bytes / record->cycles);
+        if (isnan(record->rel_error)) {
+            printf("null}");
+        } else {
+            printf("%.6e}", record->rel_error);
+        }
+    } else {
+        printf("c,%s,%" PRIu64 ",%s,%.9f,%" PRIu64 ",%.6f,%d,%s,%.0f,%s,%s,%s,%" PRIu64 ",%s,%" PRIu64 ",%" PRIu64
+               ",%" PRIu64 ",%" PRIu64 ",%.1f,%" PRIu64 ",%" PRIu64,
+               record->kernel, record->size, result, record->cycles / tsc_hz, record->cycles,
+               record->adds_per_cycle, stats->runs, host.cpu_model, tsc_hz, host.compiler, host.cflags, host.build, bytes,
+               cache_for_size(bytes),
+               stats->median, stats->p90, stats->p99, stats->max, stats->stddev, stats->ci_low, stats->ci_high);
+        for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+            printf(",");
+            print_machine_counter(perf_mode ? counters[c] : UINT64_MAX);
+        }
+        printf(",%d,%s,%" PRIu64 ",%s,%.6f,", num_threads, host.cache_mode, record->result_high, type->name,
+               (double)bytes / record->cycles);
+        if (!isnan(record->rel_error)) {
+            printf("%.6e", record->rel_error);
+        }
+        printf("\n");
+    }
+}
+
+void print_text_row(const test_record* record) {
+    const cycle_stats* stats = &record->stats;
+    const perf_sample* perf = &record->perf;
+    uint64_t size = record->size;
+    uint64_t bytes = record_bytes(record);
+
+    char working_set[32], working_set_column[48];
+    format_bytes(bytes, working_set, sizeof(working_set));
+    snprintf(working_set_column, sizeof(working_set_column), "%s %s", working_set, cache_for_size(bytes));
+
+    char result[48];
+    format_result(record, result, sizeof(result));
+    printf("%-20" PRIu64 "%-16s%-25s%-20.6f%-20" PRIu64 "%-15.6f%-16.6f",
+           size, working_set_column, result, record->cycles / tsc_hz, record->cycles, record->adds_per_cycle,
+           (double)bytes / record->cycles);
+    if (isnan(record->rel_error)) {
+        printf("%-14s", "-");
+    } else {
+        printf("%-14.3e", record->rel_error);
+    }
+
+    char ci[48];
+    snprintf(ci, sizeof(ci), "%" PRIu64 "-%" PRIu64, stats->ci_low, stats->ci_high);
+    printf("%-12" PRIu64 "%-12" PRIu64 "%-12" PRIu64 "%-12" PRIu64 "%-12.1f%-24s%-8d",
+           stats->median, stats->p90, stats->p99, stats->max, stats->stddev, ci, stats->runs);
+    if (perf_mode) {
+        uint64_t core_cycles = perf->values[PERF_CYCLES];
+        uint64_t instructions = perf->values[PERF_INSTRUCTIONS];
+        print_counter(core_cycles);
+        if (instructions == UINT64_MAX || core_cycles == 0) {
+            printf("%-8s", "n/a");
+        } else {
+            printf("%-8.2f", (double)instructions / core_cycles);
+        }
+        printf("%-16.6f", core_cycles == 0 ? 0.0 : (double)size / core_cycles);
+        print_counter(perf->values[PERF_L1D_MISSES]);
+        print_counter(perf->values[PERF_LLC_MISSES]);
+        print_counter(perf->values[PERF_STALL_CYCLES]);
+    }
+    printf("\n");
+}
+
+// Function to print the column headings shared by the per-kernel tables
+void print_text_header(int width) {
+    print_rule('=', width);
+    printf("%-20s%-16s%-25s%-20s%-20s%-15s", "Test Size", "Working Set", "Result", "Time Taken (s)", "CPU Cycles", "Adds per Cycle");
+    printf("%-16s%-14s", "Bytes per Cycle", "Rel. Error");
+    printf("%-12s%-12s%-12s%-12s%-12s%-24s%-8s", "Median", "P90", "P99", "Max", "Stddev", "Median 95% CI", "Runs");
+    if (perf_mode) {
+        printf("%-16s%-8s%-16s%-16s%-16s%-16s", "Core Cycles", "IPC", "Core Adds/Cycle", "L1D Misses", "LLC Misses", "Backend Stalls");
+    }
+    printf("\n");
+    print_rule('-', width);
+}
+
+void run_test(const kernel_entry* kernel, uint64_t* sizes, int num_sizes) {
+    const char* func_name = kernel->name;
+    uint64_t (*func)(uint64_t, uint64_t*) = kernel->func;
+    int width = perf_mode ? 329 : 241;
+
+    arena_fill(kernel->elem_type);
+    if (output_format == FORMAT_TEXT) {
+        if (kernel->elem_type == ELEM_U64) {
+            printf("\nRunning tests for function: %s\n", func_name);
+        } else {
+            printf("\nRunning tests for function: %s (%s elements)\n", func_name, element_types[kernel->elem_type].name);
+        }
+        print_text_header(width);
+    }
 
     for (int i = 0; i < num_sizes; i++) {
         uint64_t size = sizes[i];
-        uint64_t* input_data = malloc(size * sizeof(uint64_t));
-        if (input_data == NULL) {
-            fprintf(stderr, "Error: Memory allocation failed for size %" PRIu64 "\n", size);
-            exit(EXIT_FAILURE);
+        uint64_t* input_data = arena.data;
+
+        test_record record = {.kernel = func_name, .size = size, .elem_type = kernel->elem_type};
+        record.cycles = measure_cycles(func, input_data, size, element_types[kernel->elem_type].size, &record.perf, &record.stats);
+        record.adds_per_cycle = (double)size / record.cycles;
+        const wide_entry* wide = wide_kernel(func);
+        record.result = wide != NULL ? wide->wide(size, input_data, &record.result_high) : func(size, input_data);
+        record.rel_error = NAN;
+        if (element_types[kernel->elem_type].is_float) {
+            double exact = exact_reference(size);
+            record.rel_error = exact == 0 ? fabs(bits_double(record.result)) : fabs(bits_double(record.result) - exact) / fabs(exact);
         }
+        add_record(&record);
+
+        if (output_format == FORMAT_TEXT) {
+            print_text_row(&record);
+        } else {
+            print_machine_record(&record);
+        }
+        fflush(stdout);
+    }
+
+    if (output_format == FORMAT_TEXT) {
+        print_rule('=', width);
+    }
+}
 
-        for (uint64_t j = 0; j < size; j++) {
-            input_data[j] = j;
+// Function to add the CPUs of a sysfs list such as "0-3,8-11" that are also in allowed
+int parse_cpu_list(const char* text, const cpu_set_t* allowed, int* cpus, int max_cpus) {
+    int count = 0;
+    while (*text != '\0' && *text != '\n') {
+        char* end;
+        long first = strtol(text, &end, 10);
+        long last = first;
+        if (end == text) {
+            break;
+        }
+        if (*end == '-') {
+            text = end + 1;
+            last = strtol(text, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, allowed) && count < max_cpus) {
+                cpus[count++] = (int)cpu;
+            }
         }
+        text = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+// Function to read the node topology from sysfs and interleave the allowed CPUs across nodes,
+// so any pool size spreads as evenly over the nodes as the CPU counts allow
+void detect_numa(void) {
+    static int node_cpus[MAX_NUMA_NODES][MAX_THREADS];
+    int node_count[MAX_NUMA_NODES] = {0};
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+    }
 
-        double cpu_clock = 0;
-        uint64_t cycles = measure_cycles(func, input_data, size, &cpu_clock);
-        double adds_per_cycle = (double)size / cycles;
-        uint64_t result = func(size, input_data);
+    num_numa_nodes = 0;
+    for (int node = 0; node < MAX_NUMA_NODES; node++) {
+        char path[128], text[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* file = fopen(path, "r");
+        if (file == NULL) {
+            continue;
+        }
+        int found = fgets(text, sizeof(text), file) != NULL;
+        fclose(file);
+        // Memory-only nodes and nodes outside the affinity mask can't run a worker
+        if (found && (node_count[num_numa_nodes] = parse_cpu_list(text, &allowed, node_cpus[num_numa_nodes], MAX_THREADS)) > 0) {
+            numa_node_ids[num_numa_nodes++] = node;
+        }
+    }
 
-        printf("%-20" PRIu64 "%-25" PRIu64 "%-20" PRIu64 "%-20.3f%-15.6f\n", size, result, cycles, cpu_clock / 1e9, adds_per_cycle);
-        free(input_data);
+    if (num_numa_nodes == 0) {
+        // No sysfs topology: treat the machine as a single node
+        numa_node_ids[0] = 0;
+        node_count[0] = 0;
+        for (int cpu = 0; cpu < CPU_SETSIZE && node_count[0] < MAX_THREADS; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                node_cpus[0][node_count[0]++] = cpu;
+            }
+        }
+        num_numa_nodes = 1;
     }
 
-    printf("=======================================================================================================\n");
+    num_numa_cpus = 0;
+    for (int round = 0; num_numa_cpus < MAX_THREADS; round++) {
+        int added = 0;
+        for (int n = 0; n < num_numa_nodes && num_numa_cpus < MAX_THREADS; n++) {
+            if (round < node_count[n]) {
+                numa_cpus[num_numa_cpus] = node_cpus[n][round];
+                numa_cpu_node[num_numa_cpus++] = n;
+                added = 1;
+            }
+        }
+        if (!added) {
+            break;
+        }
+    }
 }
 
-int main() {
-    uint64_t test_sizes[] = {5000, 20000, 312500, 6000000, 25000000};
-    int num_sizes = sizeof(test_sizes) / sizeof(test_sizes[0]);
+// The two SMT placements --scaling compares: one worker per physical core before any sibling
+// (SMT off), or every hardware thread of a core before the next core (SMT on)
+static int num_core_cpus = 0;
+static int core_cpus[MAX_THREADS];
+static int num_sibling_cpus = 0;
+static int sibling_cpus[MAX_THREADS];
+
+// Function to order the allowed CPUs by physical core from the sysfs thread_siblings_list
+void detect_smt(void) {
+    cpu_set_t allowed, placed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+    }
+    CPU_ZERO(&placed);
+    num_core_cpus = num_sibling_cpus = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && num_sibling_cpus < MAX_THREADS; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || CPU_ISSET(cpu, &placed)) {
+            continue;
+        }
+        char path[128], text[4096];
+        int siblings[MAX_THREADS];
+        int count = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+        FILE* file = fopen(path, "r");
+        if (file != NULL) {
+            if (fgets(text, sizeof(text), file) != NULL) {
+                count = parse_cpu_list(text, &allowed, siblings, MAX_THREADS);
+            }
+            fclose(file);
+        }
+        if (count == 0) {
+            siblings[count++] = cpu;
+        }
+        core_cpus[num_core_cpus++] = cpu;
+        for (int s = 0; s < count && num_sibling_cpus < MAX_THREADS; s++) {
+            if (!CPU_ISSET(siblings[s], &placed)) {
+                CPU_SET(siblings[s], &placed);
+                sibling_cpus[num_sibling_cpus++] = siblings[s];
+            }
+        }
+    }
+    if (num_core_cpus == 0) {
+        core_cpus[num_core_cpus++] = 0;
+        sibling_cpus[num_sibling_cpus++] = 0;
+    }
+}
 
-    run_test("SingleScalar", SingleScalar, test_sizes, num_sizes);
-    run_test("Unroll2Scalar", Unroll2Scalar, test_sizes, num_sizes);
-    run_test("Unroll4Scalar", Unroll4Scalar, test_sizes, num_sizes);
-    run_test("Simd128", Simd128, test_sizes, num_sizes);
-    run_test("Simd256", Simd256, test_sizes, num_sizes);
+static uint64_t* numa_base = NULL;  // Start of the buffer being placed, so chunks know their global index
+static uint64_t (*numa_chunk_func)(uint64_t, uint64_t*) = Unroll4Scalar;
+static uint64_t numa_worker_cycles[MAX_THREADS];  // Fastest chunk of each worker over the current test's runs
+static atomic_int numa_placement_unverified = 0;  // Set once a chunk could not be bound to its node
 
+// Function to bind a chunk to the calling worker's node and fill it, so its pages are faulted
+// in on that node; the bind keeps the placement if the kernel would otherwise fall back
+uint64_t FirstTouchChunk(uint64_t count, uint64_t* input_data) {
+    uint64_t first = input_data - numa_base;
+    unsigned cpu, node;
+    if (count > 0) {
+        // Round up to whole huge pages so the last one is bound too, but never past the mapping
+        size_t bytes = (count * sizeof(uint64_t) + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        size_t left = arena.mapped_bytes - (size_t)((uint8_t*)input_data - (uint8_t*)arena.data);
+        bytes = bytes < left ? bytes : left;
+        int bound = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && node < 8 * sizeof(unsigned long)) {
+            unsigned long mask = 1ul << node;
+            bound = syscall(SYS_mbind, input_data, bytes, MPOL_BIND, &mask, 8 * sizeof(mask), 0) == 0;
+        }
+        if (!bound && atomic_exchange_explicit(&numa_placement_unverified, 1, memory_order_relaxed) == 0) {
+            fprintf(stderr, "Warning: mbind failed (%s); NUMA placement is unverified, first touch alone decides it\n",
+                    strerror(errno));
+        }
+    }
+    for (uint64_t j = 0; j < count; j++) {
+        input_data[j] = first + j;
+    }
     return 0;
 }
+
+// Function to perform multithreaded addition where worker t sums the same 2 MiB aligned
+// slice it first-touched, so every read is served by the worker's local node
+uint64_t ParallelNuma(uint64_t count, uint64_t* input_data) {
+    uint64_t final_sum = pool_run(numa_chunk_func, count, input_data, sizeof(uint64_t), HUGE_PAGE_SIZE / sizeof(uint64_t));
+    for (int t = 0; t < pool.num_workers; t++) {
+        if (pool.tasks[t].count > 0 && pool.tasks[t].cycles < numa_worker_cycles[t]) {
+            numa_worker_cycles[t] = pool.tasks[t].cycles;
+        }
+    }
+    return final_sum;
+}
+
+#define STREAM_CHUNK (8ull << 20)  // Bytes per read in --stream mode, which keeps two buffers in flight
+#define PIPELINE_MAX_DEPTH 64
+#define DEFAULT_PIPELINE_DEPTH 8
+
+// Lock-free single-producer single-consumer ring of reusable chunk buffers. The producer publishes
+// chunk n into slot n % depth by bumping head and blocks while depth chunks are unreleased; the
+// consumer sums the chunk at tail and bumps tail to hand the slot back. A chunk shorter than
+// chunk_bytes ends the pass. A persistent producer thread starts a pass when generation changes.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t head;  // Chunks published by the producer
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t tail;  // Chunks released by the consumer
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t generation;
+    atomic_int shutdown;
+    int depth;
+    uint64_t chunk_bytes;
+    uint64_t* buffers[PIPELINE_MAX_DEPTH];
+    ssize_t bytes[PIPELINE_MAX_DEPTH];  // Bytes in each published chunk, -errno on a read error
+    int fd;  // File the producer reads, or -1 to generate input_data[j] = j
+    uint64_t count;  // Elements to generate per pass when fd is -1
+    const kernel_entry* kernel;  // What the consumer runs on every chunk
+    uint64_t kernel_cycles;  // Consumer cycles inside the kernel during the last pass
+    pthread_t producer;
+} pipeline_state;
+
+static pipeline_state pipe_ring;
+
+void* pipeline_producer(void* arg) {
+    (void)arg;
+    uint64_t seen = 0;
+    uint64_t head = 0;
+    uint64_t chunk_elements = pipe_ring.chunk_bytes / sizeof(uint64_t);
+    for (;;) {
+        int spins = 0;
+        uint64_t current;
+        while ((current = atomic_load_explicit(&pipe_ring.generation, memory_order_acquire)) == seen) {
+            spin_wait(&spins);
+        }
+        seen = current;
+        if (atomic_load_explicit(&pipe_ring.shutdown, memory_order_relaxed)) {
+            return NULL;
+        }
+
+        uint64_t produced = 0;
+        off_t offset = 0;
+        for (;;) {
+            // Backpressure: wait for the consumer to release the oldest slot
+            spins = 0;
+            while (head - atomic_load_explicit(&pipe_ring.tail, memory_order_acquire) == (uint64_t)pipe_ring.depth) {
+                spin_wait(&spins);
+            }
+            int slot = head % pipe_ring.depth;
+            uint64_t* buffer = pipe_ring.buffers[slot];
+            ssize_t got;
+            if (pipe_ring.fd < 0) {
+                uint64_t n = pipe_ring.count - produced < chunk_elements ? pipe_ring.count - produced : chunk_elements;
+                for (uint64_t j = 0; j < n; j++) {
+                    buffer[j] = produced + j;
+                }
+                produced += n;
+                got = n * sizeof(uint64_t);
+            } else {
+                got = pread(pipe_ring.fd, buffer, pipe_ring.chunk_bytes, offset);
+                if (got < 0) {
+                    got = -errno;  // errno is thread-local, so hand it to the consumer with the chunk
+                }
+                offset += got > 0 ? got : 0;
+            }
+            pipe_ring.bytes[slot] = got;
+            atomic_store_explicit(&pipe_ring.head, ++head, memory_order_release);
+            if (got < (ssize_t)pipe_ring.chunk_bytes) {
+                break;
+            }
+        }
+    }
+}
+
+// Function to allocate depth chunk buffers, 2 MiB aligned so they also satisfy O_DIRECT, and start
+// the producer thread
+void pipeline_init(int depth, uint64_t chunk_bytes) {
+    pipe_ring.depth = depth;
+    pipe_ring.chunk_bytes = chunk_bytes;
+    pipe_ring.fd = -1;
+    atomic_init(&pipe_ring.head, 0);
+    atomic_init(&pipe_ring.tail, 0);
+    atomic_init(&pipe_ring.generation, 0);
+    atomic_init(&pipe_ring.shutdown, 0);
+    for (int b = 0; b < depth; b++) {
+        if (posix_memalign((void**)&pipe_ring.buffers[b], HUGE_PAGE_SIZE, chunk_bytes) != 0) {
+            fprintf(stderr, "Error: Memory allocation failed for the pipeline buffers\n");
+            exit(EXIT_FAILURE);
+        }
+        madvise(pipe_ring.buffers[b], chunk_bytes, MADV_HUGEPAGE);
+        memset(pipe_ring.buffers[b], 0, chunk_bytes);
+    }
+    if (pthread_create(&pipe_ring.producer, NULL, pipeline_producer, NULL) != 0) {
+        fprintf(stderr, "Error: Failed to create the producer thread\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void pipeline_shutdown(void) {
+    atomic_store_explicit(&pipe_ring.shutdown, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pipe_ring.generation, 1, memory_order_release);
+    pthread_join(pipe_ring.producer, NULL);
+    for (int b = 0; b < pipe_ring.depth; b++) {
+        free(pipe_ring.buffers[b]);
+    }
+}
+
+// Function to run one producer pass and sum every chunk as soon as it is published
+uint64_t pipeline_pass(void) {
+    uint64_t tail = atomic_load_explicit(&pipe_ring.tail, memory_order_relaxed);
+    uint64_t final_sum = 0;
+    pipe_ring.kernel_cycles = 0;
+    atomic_fetch_add_explicit(&pipe_ring.generation, 1, memory_order_release);
+    for (;;) {
+        int spins = 0;
+        while (atomic_load_explicit(&pipe_ring.head, memory_order_acquire) == tail) {
+            spin_wait(&spins);
+        }
+        int slot = tail % pipe_ring.depth;
+        ssize_t got = pipe_ring.bytes[slot];
+        if (got < 0) {
+            fprintf(stderr, "Error: Reading the input file failed: %s\n", strerror((int)-got));
+            exit(EXIT_FAILURE);
+        }
+        uint64_t start = read_tsc_begin();
+        final_sum += pipe_ring.kernel->func((uint64_t)got / sizeof(uint64_t), pipe_ring.buffers[slot]);
+        pipe_ring.kernel_cycles += read_tsc_end() - start;
+        atomic_store_explicit(&pipe_ring.tail, ++tail, memory_order_release);
+        if (got < (ssize_t)pipe_ring.chunk_bytes) {
+            return final_sum;
+        }
+    }
+}
+
+// Function to generate count elements through the ring while summing them, input_data is unused
+uint64_t PipelineSum(uint64_t count, uint64_t* input_data) {
+    (void)input_data;
+    pipe_ring.count = count;
+    return pipeline_pass();
+}
+
+// Function to do what run_test does outside the timed region: generate, then sum
+uint64_t GenerateThenSum(uint64_t count, uint64_t* input_data) {
+    for (uint64_t j = 0; j < count; j++) {
+        input_data[j] = j;
+    }
+    return pipe_ring.kernel->func(count, input_data);
+}
+
+// Function to open the file for streaming, with O_DIRECT so reads bypass the page cache and the
+// run measures the device, or with buffered reads where the filesystem refuses O_DIRECT (tmpfs)
+const char* stream_open(const char* path) {
+    pipe_ring.fd = open(path, O_RDONLY | O_DIRECT);
+    if (pipe_ring.fd >= 0) {
+        // Some filesystems accept the flag but reject the first aligned read
+        if (pread(pipe_ring.fd, pipe_ring.buffers[0], pipe_ring.chunk_bytes, 0) >= 0) {
+            return "O_DIRECT";
+        }
+        close(pipe_ring.fd);
+    }
+    pipe_ring.fd = open(path, O_RDONLY);
+    if (pipe_ring.fd < 0) {
+        fprintf(stderr, "Error: Cannot open %s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    posix_fadvise(pipe_ring.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return "buffered reads";
+}
+
+// Function to stream the file once through the ring, the producer reading while kernel sums the
+// chunks already read, and report end-to-end GB/s next to the kernel's own rate over the same bytes;
+// when the summing thread spends most of the wall time waiting, the limit is storage, not the ALUs
+void run_stream_test(const char* path, const kernel_entry* kernel, int depth, uint64_t chunk_bytes) {
+    pipeline_init(depth, chunk_bytes);
+    const char* method = stream_open(path);
+    struct stat st;
+    fstat(pipe_ring.fd, &st);
+    pipe_ring.kernel = kernel;
+
+    uint64_t start = read_tsc_begin();
+    uint64_t total_sum = pipeline_pass();
+    uint64_t cycles = read_tsc_end() - start;
+    uint64_t kernel_cycles = pipe_ring.kernel_cycles;
+    close(pipe_ring.fd);
+    pipeline_shutdown();
+
+    static char name[64];
+    snprintf(name, sizeof(name), "Stream%s", kernel->name);
+    uint64_t elements = (uint64_t)st.st_size / sizeof(uint64_t);
+    test_record record = {.kernel = name, .size = elements, .result = total_sum, .cycles = cycles, .rel_error = NAN};
+    record.adds_per_cycle = (double)elements / cycles;
+    record.stats = (cycle_stats){cycles, cycles, cycles, cycles, cycles, 0, cycles, cycles, 1};
+    add_record(&record);
+
+    char chunk[32];
+    format_bytes(chunk_bytes, chunk, sizeof(chunk));
+    double bytes = (double)elements * sizeof(uint64_t);
+    double wait_share = cycles > kernel_cycles ? (double)(cycles - kernel_cycles) / cycles : 0;
+    if (output_format == FORMAT_TEXT) {
+        int width = perf_mode ? 329 : 241;
+        printf("\nStreaming %s with %s through %d %s buffers, summed by %s\n", path, method, depth, chunk, kernel->name);
+        print_text_header(width);
+        print_text_row(&record);
+        print_rule('=', width);
+    } else {
+        print_machine_record(&record);
+    }
+    fprintf(log_output, "End to end: %.2f GB/s; %s alone: %.2f GB/s; waiting on reads %.0f%% of the time, %s-bound\n",
+            bytes * tsc_hz / cycles / 1e9, kernel->name, kernel_cycles > 0 ? bytes * tsc_hz / kernel_cycles / 1e9 : 0.0,
+            wait_share * 100, wait_share > 0.5 ? "storage" : "compute");
+}
+
+// Function to compare generate-then-sum over the arena with the pipelined version, where the
+// producer generates chunk_bytes chunks into the ring while the consumer sums finished ones
+void run_pipeline_test(uint64_t* sizes, int num_sizes, int depth, uint64_t chunk_bytes) {
+    int width = perf_mode ? 329 : 241;
+    const kernel_entry* kernel = best_kernel(chunk_bytes / sizeof(uint64_t));
+    pipeline_init(depth, chunk_bytes);
+    pipe_ring.kernel = kernel;
+
+    static char names[2][64];
+    snprintf(names[0], sizeof(names[0]), "GenerateThenSum%s", kernel->name);
+    snprintf(names[1], sizeof(names[1]), "Pipeline%s", kernel->name);
+    uint64_t (*funcs[2])(uint64_t, uint64_t*) = {GenerateThenSum, PipelineSum};
+    uint64_t cycles[2][MAX_SIZES];
+
+    char chunk[32];
+    format_bytes(chunk_bytes, chunk, sizeof(chunk));
+    for (int mode = 0; mode < 2; mode++) {
+        if (output_format == FORMAT_TEXT) {
+            printf("\nRunning tests for function: %s", names[mode]);
+            printf(mode == 0 ? " (fill the arena, then sum it)\n" : " (%d %s buffers in a ring)\n", depth, chunk);
+            print_text_header(width);
+        }
+        for (int i = 0; i < num_sizes; i++) {
+            uint64_t size = sizes[i];
+            test_record record = {.kernel = names[mode], .size = size, .rel_error = NAN};
+            record.cycles = measure_cycles(funcs[mode], arena.data, size, sizeof(uint64_t), &record.perf, &record.stats);
+            record.adds_per_cycle = (double)size / record.cycles;
+            record.result = funcs[mode](size, arena.data);
+            add_record(&record);
+            cycles[mode][i] = record.cycles;
+
+            if (output_format == FORMAT_TEXT) {
+                print_text_row(&record);
+            } else {
+                print_machine_record(&record);
+            }
+            fflush(stdout);
+        }
+        if (output_format == FORMAT_TEXT) {
+            print_rule('=', width);
+        }
+    }
+    pipeline_shutdown();
+
+    fprintf(log_output, "\nPipelined throughput with %s:\n", kernel->name);
+    for (int i = 0; i < num_sizes; i++) {
+        double bytes = (double)sizes[i] * sizeof(uint64_t);
+        fprintf(log_output, "  %-20" PRIu64 "serial %8.2f GB/s  pipelined %8.2f GB/s  speedup %.2fx\n", sizes[i],
+                bytes * tsc_hz / cycles[0][i] / 1e9, bytes * tsc_hz / cycles[1][i] / 1e9, (double)cycles[0][i] / cycles[1][i]);
+    }
+}
+
+#define PREFIX_QUERIES 1024  // Random ranges answered per run of the query benchmark
+#define PREFIX_UPDATES 16  // Random point updates per run of the incremental rebuild benchmark
+static prefix_index prefix;
+static uint64_t prefix_queries[PREFIX_QUERIES][2];
+static uint64_t prefix_updates[PREFIX_UPDATES];
+
+// Function to rebuild the whole index for measure_cycles, the tables were allocated and faulted in
+// by prefix_build so only the scan is timed; returns the total
+uint64_t PrefixBuild(uint64_t count, uint64_t* input_data) {
+    (void)count;
+    (void)input_data;
+    prefix_rebuild(&prefix);
+    return prefix.block_prefix[prefix.num_blocks];
+}
+
+// Function to answer the query batch by rescanning each range with the best kernel for its length
+uint64_t ScanQueries(uint64_t count, uint64_t* input_data) {
+    (void)count;
+    uint64_t total = 0;
+    for (int q = 0; q < PREFIX_QUERIES; q++) {
+        uint64_t first = prefix_queries[q][0], length = prefix_queries[q][1] - first;
+        total += best_kernel(length)->func(length, input_data + first);
+    }
+    return total;
+}
+
+uint64_t IndexQueries(uint64_t count, uint64_t* input_data) {
+    (void)count;
+    (void)input_data;
+    uint64_t total = 0;
+    for (int q = 0; q < PREFIX_QUERIES; q++) {
+        total += prefix_range_sum(&prefix, prefix_queries[q][0], prefix_queries[q][1]);
+    }
+    return total;
+}
+
+// Function to apply the point updates and bring the index up to date, flipping the low bit of each
+// updated element so the input stays close to what the scan kernels see
+uint64_t UpdateRefresh(uint64_t count, uint64_t* input_data) {
+    (void)count;
+    for (int u = 0; u < PREFIX_UPDATES; u++) {
+        prefix_update(&prefix, prefix_updates[u], input_data[prefix_updates[u]] ^ 1);
+    }
+    prefix_refresh(&prefix);
+    return prefix.block_prefix[prefix.num_blocks];
+}
+
+// Function to compare the prefix index with rescanning: build cost as a table, then per size the
+// cycles per random range query both ways, the incremental rebuild after point updates, and how
+// many queries it takes for the index to pay for its build
+void run_prefix_test(uint64_t* sizes, int num_sizes) {
+    int width = perf_mode ? 329 : 241;
+    const char* name = "PrefixBuildScalar";
+    if (cpu_features & FEATURE_AVX2) {
+        name = "PrefixBuildSimd256";
+    }
+    uint64_t build[MAX_SIZES], scan[MAX_SIZES], query[MAX_SIZES], refresh[MAX_SIZES];
+
+    if (output_format == FORMAT_TEXT) {
+        printf("\nRunning tests for function: %s (%d element blocks)\n", name, PREFIX_BLOCK);
+        print_text_header(width);
+    }
+    for (int i = 0; i < num_sizes; i++) {
+        uint64_t size = sizes[i];
+        prefix_build(&prefix, arena.data, size);
+        test_record record = {.kernel = name, .size = size, .rel_error = NAN};
+        record.cycles = measure_cycles(PrefixBuild, arena.data, size, sizeof(uint64_t), &record.perf, &record.stats);
+        record.adds_per_cycle = (double)size / record.cycles;
+        record.result = PrefixBuild(size, arena.data);
+        add_record(&record);
+        build[i] = record.cycles;
+        if (output_format == FORMAT_TEXT) {
+            print_text_row(&record);
+        } else {
+            print_machine_record(&record);
+        }
+        fflush(stdout);
+
+        // The same pseudo-random ranges and positions for every run of this size
+        uint64_t state = 0x9e3779b97f4a7c15ull ^ size;
+        for (int q = 0; q < PREFIX_QUERIES; q++) {
+            for (int e = 0; e < 2; e++) {
+                state ^= state << 13, state ^= state >> 7, state ^= state << 17;
+                prefix_queries[q][e] = state % (size + 1);
+            }
+            if (prefix_queries[q][0] > prefix_queries[q][1]) {
+                uint64_t swap = prefix_queries[q][0];
+                prefix_queries[q][0] = prefix_queries[q][1];
+                prefix_queries[q][1] = swap;
+            }
+        }
+        for (int u = 0; u < PREFIX_UPDATES; u++) {
+            state ^= state << 13, state ^= state >> 7, state ^= state << 17;
+            prefix_updates[u] = state % size;
+        }
+
+        scan[i] = measure_cycles(ScanQueries, arena.data, size, sizeof(uint64_t), NULL, NULL);
+        query[i] = measure_cycles(IndexQueries, arena.data, size, sizeof(uint64_t), NULL, NULL);
+        if (ScanQueries(size, arena.data) != IndexQueries(size, arena.data)) {
+            fprintf(stderr, "Error: the prefix index disagrees with the scan kernels at size %" PRIu64 "\n", size);
+            exit(EXIT_FAILURE);
+        }
+        refresh[i] = measure_cycles(UpdateRefresh, arena.data, size, sizeof(uint64_t), NULL, NULL);
+        if (ScanQueries(size, arena.data) != IndexQueries(size, arena.data)) {
+            fprintf(stderr, "Error: the refreshed prefix index disagrees with the scan kernels at size %" PRIu64 "\n", size);
+            exit(EXIT_FAILURE);
+        }
+        prefix_free(&prefix);
+        // Undo the updates before the next size builds over the arena
+        arena.elem_type = -1;
+        arena_fill(ELEM_U64);
+    }
+    if (output_format == FORMAT_TEXT) {
+        print_rule('=', width);
+    }
+    prefix = (prefix_index){0};
+
+    fprintf(log_output, "\nRange queries over %d random ranges, cycles per query (scan uses the best kernel per range):\n", PREFIX_QUERIES);
+    char refresh_label[32];
+    snprintf(refresh_label, sizeof(refresh_label), "%d updates", PREFIX_UPDATES);
+    fprintf(log_output, "  %-20s%14s%14s%14s%20s%16s\n", "Test Size", "Build", "Scan query", "Index query", refresh_label, "Break-even");
+    for (int i = 0; i < num_sizes; i++) {
+        double scan_query = (double)scan[i] / PREFIX_QUERIES, index_query = (double)query[i] / PREFIX_QUERIES;
+        fprintf(log_output, "  %-20" PRIu64 "%14" PRIu64 "%14.1f%14.1f%20" PRIu64, sizes[i], build[i], scan_query, index_query, refresh[i]);
+        if (scan_query > index_query) {
+            fprintf(log_output, "%10.0f queries\n", build[i] / (scan_query - index_query));
+        } else {
+            fprintf(log_output, "%16s\n", "never");
+        }
+    }
+}
+
+#define DEFAULT_BATCH_ARRAYS 1000  // Arrays per call in --batch mode
+
+static sum_span* batch_spans = NULL;
+static uint64_t* batch_results = NULL;
+static uint64_t batch_num_spans = 0;
+static void (*batch_func)(const sum_span*, uint64_t, uint64_t*) = NULL;
+static const kernel_entry* batch_loop_kernel = NULL;
+
+// Function to sum the batch one call per array, the baseline the batched kernels have to beat
+void BatchLoop(const sum_span* spans, uint64_t num_spans, uint64_t* results) {
+    for (uint64_t s = 0; s < num_spans; s++) {
+        results[s] = batch_loop_kernel->func(spans[s].count, spans[s].data);
+    }
+}
+
+// Function to run batch_func over the current spans for measure_cycles, returns the sum of the results
+uint64_t BatchRun(uint64_t count, uint64_t* input_data) {
+    (void)count;
+    (void)input_data;
+    batch_func(batch_spans, batch_num_spans, batch_results);
+    uint64_t total = 0;
+    for (uint64_t s = 0; s < batch_num_spans; s++) {
+        total += batch_results[s];
+    }
+    return total;
+}
+
+// Function to sum num_arrays consecutive arrays of each test size per call, first by looping over
+// the best single-array kernel and then with every supported batched kernel, checking each result
+// against the loop and reporting cycles per array
+void run_batch_test(uint64_t* sizes, int num_sizes, uint64_t num_arrays) {
+    int width = perf_mode ? 329 : 241;
+    const int num_funcs = num_batch_kernels + 1;
+    uint64_t cycles[MAX_SIZES][num_batch_kernels + 1];
+    uint64_t* expected = malloc(num_sizes * num_arrays * sizeof(uint64_t));
+    batch_spans = malloc(num_arrays * sizeof(sum_span));
+    batch_results = malloc(num_arrays * sizeof(uint64_t));
+    if (expected == NULL || batch_spans == NULL || batch_results == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for %" PRIu64 " arrays\n", num_arrays);
+        exit(EXIT_FAILURE);
+    }
+    batch_num_spans = num_arrays;
+
+    static char loop_names[MAX_SIZES][64];
+    for (int f = 0; f < num_funcs; f++) {
+        const batch_entry* entry = f > 0 ? &batch_kernels[f - 1] : NULL;
+        if (entry != NULL && (entry->required_features & ~cpu_features) != 0) {
+            fprintf(log_output, "\nSkipping %s: the CPU does not support", entry->name);
+            print_missing_features(entry->required_features & ~cpu_features);
+            fprintf(log_output, "\n");
+            for (int i = 0; i < num_sizes; i++) {
+                cycles[i][f] = 0;
+            }
+            continue;
+        }
+        if (output_format == FORMAT_TEXT) {
+            printf("\nRunning tests for function: %s (%" PRIu64 " arrays per call, test size counts all of them)\n",
+                   entry != NULL ? entry->name : "Loop<best kernel>", num_arrays);
+            print_text_header(width);
+        }
+        for (int i = 0; i < num_sizes; i++) {
+            uint64_t size = sizes[i];
+            for (uint64_t s = 0; s < num_arrays; s++) {
+                batch_spans[s] = (sum_span){arena.data + s * size, size};
+            }
+            const char* name = entry != NULL ? entry->name : loop_names[i];
+            if (entry == NULL) {
+                batch_loop_kernel = best_kernel(size);
+                snprintf(loop_names[i], sizeof(loop_names[i]), "Loop%s", batch_loop_kernel->name);
+            }
+            batch_func = entry != NULL ? entry->func : BatchLoop;
+
+            uint64_t total = num_arrays * size;
+            test_record record = {.kernel = name, .size = total, .rel_error = NAN};
+            record.cycles = measure_cycles(BatchRun, arena.data, total, sizeof(uint64_t), &record.perf, &record.stats);
+            record.adds_per_cycle = (double)total / record.cycles;
+            record.result = BatchRun(total, arena.data);
+            add_record(&record);
+            cycles[i][f] = record.cycles;
+
+            if (entry == NULL) {
+                memcpy(expected + i * num_arrays, batch_results, num_arrays * sizeof(uint64_t));
+            } else if (memcmp(expected + i * num_arrays, batch_results, num_arrays * sizeof(uint64_t)) != 0) {
+                fprintf(stderr, "Error: %s disagrees with the single-array kernel at size %" PRIu64 "\n", entry->name, size);
+                exit(EXIT_FAILURE);
+            }
+            if (output_format == FORMAT_TEXT) {
+                print_text_row(&record);
+            } else {
+                print_machine_record(&record);
+            }
+            fflush(stdout);
+        }
+        if (output_format == FORMAT_TEXT) {
+            print_rule('=', width);
+        }
+    }
+
+    fprintf(log_output, "\nCycles per array, %" PRIu64 " arrays per call (speedup over the loop):\n", num_arrays);
+    fprintf(log_output, "  %-20s%-24s", "Array Size", "Loop");
+    for (int f = 1; f < num_funcs; f++) {
+        fprintf(log_output, "%-28s", batch_kernels[f - 1].name);
+    }
+    fprintf(log_output, "\n");
+    for (int i = 0; i < num_sizes; i++) {
+        double loop = (double)cycles[i][0] / num_arrays;
+        fprintf(log_output, "  %-20" PRIu64 "%-24.1f", sizes[i], loop);
+        for (int f = 1; f < num_funcs; f++) {
+            if (cycles[i][f] == 0) {
+                fprintf(log_output, "%-28s", "-");
+                continue;
+            }
+            char cell[32];
+            double batched = (double)cycles[i][f] / num_arrays;
+            snprintf(cell, sizeof(cell), "%.1f (%.2fx)", batched, loop / batched);
+            fprintf(log_output, "%-28s", cell);
+        }
+        fprintf(log_output, "\n");
+    }
+
+    free(expected);
+    free(batch_spans);
+    free(batch_results);
+}
+
+static void (*aggregate_func)(uint64_t, const uint64_t*, aggregate_stats*) = NULL;
+static aggregate_stats aggregate_result;
+
+// Function to run aggregate_func for measure_cycles, returns the sum
+uint64_t AggregateRun(uint64_t count, uint64_t* input_data) {
+    aggregate_func(count, input_data, &aggregate_result);
+    return aggregate_result.sum;
+}
+
+// Function to time every supported aggregate kernel fused and as separate passes, check both
+// against the scalar fused result, and report the bandwidth each way and the aggregates themselves
+void run_aggregate_test(uint64_t* sizes, int num_sizes) {
+    int width = perf_mode ? 329 : 241;
+    uint64_t cycles[MAX_SIZES][2 * (sizeof(aggregate_kernels) / sizeof(aggregate_kernels[0]))];
+    aggregate_stats expected[MAX_SIZES];
+    static char names[2 * (sizeof(aggregate_kernels) / sizeof(aggregate_kernels[0]))][64];
+
+    for (int i = 0; i < num_sizes; i++) {
+        AggregateScalar(sizes[i], arena.data, &expected[i]);
+    }
+    for (int f = 0; f < 2 * num_aggregate_kernels; f++) {
+        const aggregate_entry* entry = &aggregate_kernels[f / 2];
+        int fused = f % 2 == 0;
+        snprintf(names[f], sizeof(names[f]), "%s%s", fused ? "Aggregate" : "SeparatePasses", entry->name);
+        if ((entry->required_features & ~cpu_features) != 0) {
+            fprintf(log_output, "\nSkipping %s: the CPU does not support", names[f]);
+            print_missing_features(entry->required_features & ~cpu_features);
+            fprintf(log_output, "\n");
+            for (int i = 0; i < num_sizes; i++) {
+                cycles[i][f] = 0;
+            }
+            continue;
+        }
+        aggregate_func = fused ? entry->fused : entry->separate;
+        if (output_format == FORMAT_TEXT) {
+            printf("\nRunning tests for function: %s (sum, min, max, count and sum of squares%s)\n", names[f],
+                   fused ? " in one pass" : ", one pass each");
+            print_text_header(width);
+        }
+        for (int i = 0; i < num_sizes; i++) {
+            uint64_t size = sizes[i];
+            test_record record = {.kernel = names[f], .size = size, .rel_error = NAN};
+            record.cycles = measure_cycles(AggregateRun, arena.data, size, sizeof(uint64_t), &record.perf, &record.stats);
+            record.adds_per_cycle = (double)size / record.cycles;
+            record.result = AggregateRun(size, arena.data);
+            add_record(&record);
+            cycles[i][f] = record.cycles;
+
+            const aggregate_stats* want = &expected[i];
+            if (aggregate_result.sum != want->sum || aggregate_result.min != want->min || aggregate_result.max != want->max ||
+                aggregate_result.count != want->count || aggregate_result.sum_squares != want->sum_squares) {
+                fprintf(stderr, "Error: %s disagrees with AggregateScalar at size %" PRIu64 "\n", names[f], size);
+                exit(EXIT_FAILURE);
+            }
+            if (output_format == FORMAT_TEXT) {
+                print_text_row(&record);
+            } else {
+                print_machine_record(&record);
+            }
+            fflush(stdout);
+        }
+        if (output_format == FORMAT_TEXT) {
+            print_rule('=', width);
+        }
+    }
+
+    fprintf(log_output, "\nAggregates, GB/s of input fused vs separate passes:\n");
+    for (int i = 0; i < num_sizes; i++) {
+        const aggregate_stats* stats = &expected[i];
+        long double mean = stats->count > 0 ? (long double)stats->sum / stats->count : 0;
+        long double variance = stats->count > 0 ? (long double)stats->sum_squares / stats->count - mean * mean : 0;
+        char squares[48];
+        format_u128((uint64_t)(stats->sum_squares >> 64), (uint64_t)stats->sum_squares, squares, sizeof(squares));
+        fprintf(log_output, "  %-20" PRIu64 "min %" PRIu64 ", max %" PRIu64 ", mean %.6Lg, stddev %.6Lg, sum of squares %s\n",
+                sizes[i], stats->min, stats->max, mean, sqrtl(variance > 0 ? variance : 0), squares);
+        double bytes = (double)sizes[i] * sizeof(uint64_t);
+        for (int f = 0; f < 2 * num_aggregate_kernels; f += 2) {
+            if (cycles[i][f] == 0) {
+                continue;
+            }
+            fprintf(log_output, "  %-20s%-10s fused %8.2f GB/s  separate %8.2f GB/s  speedup %.2fx\n", "", aggregate_kernels[f / 2].name,
+                    bytes * tsc_hz / cycles[i][f] / 1e9, bytes * tsc_hz / cycles[i][f + 1] / 1e9, (double)cycles[i][f + 1] / cycles[i][f]);
+        }
+    }
+}
+
+static uint64_t (*filter_func)(uint64_t, uint64_t*, uint64_t, uint64_t) = NULL;
+
+// Function to run filter_func over [FILTER_LO, FILTER_HI) for measure_cycles
+uint64_t FilterRun(uint64_t count, uint64_t* input_data) {
+    return filter_func(count, input_data, FILTER_LO, FILTER_HI);
+}
+
+// Function to run every supported filtered kernel through run_test once per selectivity, check
+// that they agree, and chart adds per cycle against selectivity at the largest size, where the
+// branchy kernel's misprediction cliff around 50% shows up
+void run_filter_test(uint64_t* sizes, int num_sizes, const int* selectivities, int num_selectivities) {
+    static char names[MAX_SELECTIVITIES][sizeof(filter_kernels) / sizeof(filter_kernels[0])][64];
+    double adds_per_cycle[MAX_SELECTIVITIES][sizeof(filter_kernels) / sizeof(filter_kernels[0])];
+
+    for (int s = 0; s < num_selectivities; s++) {
+        input_selectivity = selectivities[s];
+        char label[16];
+        if (selectivities[s] == SELECTIVITY_RANDOM) {
+            snprintf(label, sizeof(label), "random");
+        } else {
+            snprintf(label, sizeof(label), "%d%%", selectivities[s]);
+        }
+        int first_record = num_records;
+        for (int k = 0; k < num_filter_kernels; k++) {
+            adds_per_cycle[s][k] = 0;
+            if ((filter_kernels[k].required_features & ~cpu_features) != 0) {
+                continue;
+            }
+            snprintf(names[s][k], sizeof(names[s][k]), "%s[%s]", filter_kernels[k].name, label);
+            kernel_entry entry = {names[s][k], FilterRun, filter_kernels[k].required_features, -1, NULL, ELEM_U64};
+            filter_func = filter_kernels[k].func;
+            run_test(&entry, sizes, num_sizes);
+            adds_per_cycle[s][k] = records[num_records - 1].adds_per_cycle;
+        }
+        for (int r = first_record + num_sizes; r < num_records; r++) {
+            if (records[r].result != records[first_record + (r - first_record) % num_sizes].result) {
+                fprintf(stderr, "Error: %s disagrees with %s at size %" PRIu64 "\n", records[r].kernel,
+                        records[first_record + (r - first_record) % num_sizes].kernel, records[r].size);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    input_selectivity = SELECTIVITY_NONE;
+
+    fprintf(log_output, "\nFiltered sums, adds per cycle at %" PRIu64 " elements by selectivity:\n", sizes[num_sizes - 1]);
+    fprintf(log_output, "  %-12s", "Selectivity");
+    for (int k = 0; k < num_filter_kernels; k++) {
+        fprintf(log_output, "%-24s", filter_kernels[k].name);
+    }
+    fprintf(log_output, "\n");
+    for (int s = 0; s < num_selectivities; s++) {
+        char label[16];
+        if (selectivities[s] == SELECTIVITY_RANDOM) {
+            snprintf(label, sizeof(label), "random");
+        } else {
+            snprintf(label, sizeof(label), "%d%%", selectivities[s]);
+        }
+        fprintf(log_output, "  %-12s", label);
+        for (int k = 0; k < num_filter_kernels; k++) {
+            if (adds_per_cycle[s][k] > 0) {
+                fprintf(log_output, "%-24.4f", adds_per_cycle[s][k]);
+            } else {
+                fprintf(log_output, "%-24s", "-");
+            }
+        }
+        fprintf(log_output, "\n");
+    }
+}
+
+// Function to parse a --filter list of percentages from 0 to 100 and the word random
+int parse_selectivities(const char* arg, int* selectivities) {
+    int count = 0;
+    const char* p = arg;
+    while (*p != '\0') {
+        if (count == MAX_SELECTIVITIES) {
+            return -1;
+        }
+        char* end;
+        if (strncmp(p, "random", 6) == 0) {
+            selectivities[count++] = SELECTIVITY_RANDOM;
+            end = (char*)p + 6;
+        } else {
+            long percent = strtol(p, &end, 10);
+            if (end == p || percent < 0 || percent > 100) {
+                return -1;
+            }
+            selectivities[count++] = (int)percent;
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return -1;
+        }
+        p = end;
+    }
+    return count;
+}
+
+// Function to time the compressed-input kernels over both encodings of every test size, next to
+// the best raw kernel. Bytes per cycle counts the compressed bytes the kernel actually reads, adds
+// per cycle counts the elements they stand for
+void run_packed_test(uint64_t* sizes, int num_sizes) {
+    int width = perf_mode ? 329 : 241;
+    uint64_t* encoded[MAX_SIZES][2];
+    uint64_t encoded_bytes[MAX_SIZES][2];
+    uint64_t encode_cycles[MAX_SIZES][2];
+    uint64_t raw_cycles[MAX_SIZES];
+    uint64_t packed_cycles[MAX_SIZES][sizeof(packed_kernels) / sizeof(packed_kernels[0])];
+    static const char* encoding_names[2] = {"bit-packed FOR", "delta + FOR"};
+
+    for (int i = 0; i < num_sizes; i++) {
+        uint64_t size = sizes[i];
+        raw_cycles[i] = measure_cycles(best_kernel(size)->func, arena.data, size, sizeof(uint64_t), NULL, NULL);
+        for (int e = 0; e < 2; e++) {
+            // Allocate the raw size at least, cold-cache eviction flushes size * 8 bytes from the input
+            uint64_t words = size + 3 * (size / PACK_BLOCK);
+            encoded[i][e] = malloc(words * sizeof(uint64_t));
+            if (encoded[i][e] == NULL) {
+                fprintf(stderr, "Error: Memory allocation failed for the encoded input\n");
+                exit(EXIT_FAILURE);
+            }
+            memset(encoded[i][e], 0, words * sizeof(uint64_t));
+            uint64_t start = read_tsc_begin();
+            encoded_bytes[i][e] = pack_input(arena.data, size, encoded[i][e], e) * sizeof(uint64_t);
+            encode_cycles[i][e] = read_tsc_end() - start;
+        }
+    }
+
+    uint64_t expected[MAX_SIZES];
+    for (int i = 0; i < num_sizes; i++) {
+        expected[i] = best_kernel(sizes[i])->func(sizes[i], arena.data);
+    }
+    for (int k = 0; k < num_packed_kernels; k++) {
+        const packed_entry* entry = &packed_kernels[k];
+        for (int i = 0; i < num_sizes; i++) {
+            packed_cycles[i][k] = 0;
+        }
+        if (!kernel_supported(&entry->kernel)) {
+            fprintf(log_output, "\nSkipping %s: the CPU does not support", entry->kernel.name);
+            print_missing_features(entry->kernel.required_features & ~cpu_features);
+            fprintf(log_output, "\n");
+            continue;
+        }
+        if (output_format == FORMAT_TEXT) {
+            printf("\nRunning tests for function: %s (%s blocks of %d, working set is the encoded size)\n",
+                   entry->kernel.name, encoding_names[entry->encoding], PACK_BLOCK);
+            print_text_header(width);
+        }
+        for (int i = 0; i < num_sizes; i++) {
+            uint64_t size = sizes[i];
+            uint64_t* input_data = encoded[i][entry->encoding];
+            test_record record = {.kernel = entry->kernel.name, .size = size, .rel_error = NAN};
+            record.bytes = encoded_bytes[i][entry->encoding];
+            record.cycles = measure_cycles(entry->kernel.func, input_data, size, sizeof(uint64_t), &record.perf, &record.stats);
+            record.adds_per_cycle = (double)size / record.cycles;
+            record.result = entry->kernel.func(size, input_data);
+            add_record(&record);
+            packed_cycles[i][k] = record.cycles;
+            if (record.result != expected[i]) {
+                fprintf(stderr, "Error: %s disagrees with the raw kernels at size %" PRIu64 "\n", entry->kernel.name, size);
+                exit(EXIT_FAILURE);
+            }
+            if (output_format == FORMAT_TEXT) {
+                print_text_row(&record);
+            } else {
+                print_machine_record(&record);
+            }
+            fflush(stdout);
+        }
+        if (output_format == FORMAT_TEXT) {
+            print_rule('=', width);
+        }
+    }
+
+    fprintf(log_output, "\nCompressed input, adds per cycle against the best raw kernel:\n");
+    for (int i = 0; i < num_sizes; i++) {
+        fprintf(log_output, "  %-20" PRIu64 "raw %s %.3f", sizes[i], best_kernel(sizes[i])->name, (double)sizes[i] / raw_cycles[i]);
+        for (int e = 0; e < 2; e++) {
+            fprintf(log_output, "; %s %.1fx smaller, encoded at %.2f elements per cycle", encoding_names[e],
+                    (double)sizes[i] * sizeof(uint64_t) / encoded_bytes[i][e], (double)sizes[i] / encode_cycles[i][e]);
+        }
+        fprintf(log_output, "\n");
+        for (int k = 0; k < num_packed_kernels; k++) {
+            if (packed_cycles[i][k] > 0) {
+                fprintf(log_output, "  %-20s%-22s%8.3f adds per cycle  %6.2fx raw\n", "", packed_kernels[k].kernel.name,
+                        (double)sizes[i] / packed_cycles[i][k], (double)raw_cycles[i] / packed_cycles[i][k]);
+            }
+        }
+    }
+    for (int i = 0; i < num_sizes; i++) {
+        free(encoded[i][0]);
+        free(encoded[i][1]);
+    }
+}
+
+// STREAM triad, a[i] = b[i] + q * c[i], split over the pool; input_data is the b array and the
+// other two are found at the same offset
+static double* triad_a = NULL;
+static double* triad_b = NULL;
+static double* triad_c = NULL;
+
+uint64_t TriadChunk(uint64_t count, uint64_t* input_data) {
+    const double* b = (const double*)input_data;
+    uint64_t offset = b - triad_b;
+    double* a = triad_a + offset;
+    const double* c = triad_c + offset;
+    for (uint64_t i = 0; i < count; i++) {
+        a[i] = b[i] + 3.0 * c[i];
+    }
+    return 0;
+}
+
+uint64_t StreamTriad(uint64_t count, uint64_t* input_data) {
+    return pool_run(TriadChunk, count, input_data, sizeof(double), CACHE_LINE_SIZE / sizeof(double));
+}
+
+// Function to run every parallel kernel at 1 to max_threads workers for each SMT placement, next to a
+// STREAM triad at the same thread count, and report speedup over one thread, parallel efficiency, GB/s
+// and the share of the best triad bandwidth, plus the fewest threads within 5% of the best rate.
+// Every size runs through the pool, calibrated crossovers are suspended while this runs
+void run_scaling_test(uint64_t* sizes, int num_sizes, int max_threads) {
+    enum { MAX_PLACEMENTS = 2 };
+    const char* placement_names[MAX_PLACEMENTS] = {"SMT off, one thread per core first", "SMT on, core siblings first"};
+    int* placement_lists[MAX_PLACEMENTS] = {core_cpus, sibling_cpus};
+    int placement_sizes[MAX_PLACEMENTS] = {num_core_cpus, num_sibling_cpus};
+    const char* placement_tags[MAX_PLACEMENTS] = {"smt-off", "smt-on"};
+    int num_placements = num_sibling_cpus > num_core_cpus ? 2 : 1;
+    if (num_placements == 1) {
+        placement_names[0] = "no SMT siblings, one thread per core";
+        placement_tags[0] = "cores";
+    }
+    int saved_threads = num_threads;
+
+    // STREAM's rule: every array at least four times the largest cache, within a quarter of RAM for all three
+    uint64_t largest_cache = num_caches > 0 ? caches[num_caches - 1].size : (64ull << 20);
+    uint64_t triad_count = 4 * largest_cache / sizeof(double);
+    uint64_t ram_limit = (uint64_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) / 12 / sizeof(double);
+    triad_count = triad_count < ram_limit ? triad_count : ram_limit;
+    double* triad_arrays[3];
+    for (int a = 0; a < 3; a++) {
+        if (posix_memalign((void**)&triad_arrays[a], HUGE_PAGE_SIZE, triad_count * sizeof(double)) != 0) {
+            fprintf(stderr, "Error: Memory allocation failed for the triad arrays\n");
+            exit(EXIT_FAILURE);
+        }
+        madvise(triad_arrays[a], triad_count * sizeof(double), MADV_HUGEPAGE);
+        for (uint64_t i = 0; i < triad_count; i++) {
+            triad_arrays[a][i] = 1.0;
+        }
+    }
+    triad_a = triad_arrays[0], triad_b = triad_arrays[1], triad_c = triad_arrays[2];
+
+    int num_parallel = 0;
+    const kernel_entry* parallel[8];
+    uint64_t saved_crossover[8];
+    for (int k = 0; k < num_kernels && num_parallel < 8; k++) {
+        if (kernels[k].parallel != NULL && kernel_supported(&kernels[k])) {
+            parallel[num_parallel] = &kernels[k];
+            saved_crossover[num_parallel++] = kernels[k].parallel->serial_crossover;
+            kernels[k].parallel->serial_crossover = 0;
+        }
+    }
+
+    int most_threads = max_threads > 0 ? max_threads : num_sibling_cpus;
+    uint64_t* cycles = malloc((size_t)num_placements * 8 * num_sizes * (most_threads + 1) * sizeof(uint64_t));
+    if (cycles == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed for the scaling results\n");
+        exit(EXIT_FAILURE);
+    }
+#define SCALING_CYCLES(p, k, i, t) cycles[(((size_t)(p) * 8 + (k)) * num_sizes + (i)) * (most_threads + 1) + (t)]
+    static double triad_gbs[MAX_PLACEMENTS][MAX_THREADS + 1];
+    static char names[MAX_PLACEMENTS][8][MAX_THREADS + 1][64];
+    double peak = 0;
+    for (int p = 0; p < num_placements; p++) {
+        memcpy(placement_cpus, placement_lists[p], placement_sizes[p] * sizeof(int));
+        num_placement_cpus = placement_sizes[p];
+        int top = max_threads > 0 ? max_threads : placement_sizes[p];
+        for (int t = 1; t <= top; t++) {
+            pool_resize(t);
+            uint64_t triad_cycles = measure_cycles(StreamTriad, (uint64_t*)triad_b, triad_count, sizeof(double), NULL, NULL);
+            triad_gbs[p][t] = 3.0 * triad_count * sizeof(double) * tsc_hz / triad_cycles / 1e9;
+            peak = triad_gbs[p][t] > peak ? triad_gbs[p][t] : peak;
+            for (int k = 0; k < num_parallel; k++) {
+                snprintf(names[p][k][t], sizeof(names[p][k][t]), "%s[%dT %s]", parallel[k]->name, t, placement_tags[p]);
+                for (int i = 0; i < num_sizes; i++) {
+                    test_record record = {.kernel = names[p][k][t], .size = sizes[i], .rel_error = NAN};
+                    record.cycles = measure_cycles(parallel[k]->func, arena.data, sizes[i], sizeof(uint64_t), &record.perf, &record.stats);
+                    record.adds_per_cycle = (double)sizes[i] / record.cycles;
+                    record.result = parallel[k]->func(sizes[i], arena.data);
+                    add_record(&record);
+                    SCALING_CYCLES(p, k, i, t) = record.cycles;
+                    if (output_format != FORMAT_TEXT) {
+                        print_machine_record(&record);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int p = 0; p < num_placements; p++) {
+        int top = max_threads > 0 ? max_threads : placement_sizes[p];
+        fprintf(log_output, "\nScaling with %s, CPUs in order:", placement_names[p]);
+        for (int c = 0; c < placement_sizes[p]; c++) {
+            fprintf(log_output, "%s%d", c > 0 ? "," : " ", placement_lists[p][c]);
+        }
+        fprintf(log_output, "\n  STREAM triad GB/s by threads:");
+        for (int t = 1; t <= top; t++) {
+            fprintf(log_output, " %d: %.2f", t, triad_gbs[p][t]);
+        }
+        fprintf(log_output, "\n");
+        for (int k = 0; k < num_parallel; k++) {
+            fprintf(log_output, "\n  %s\n", parallel[k]->name);
+            fprintf(log_output, "  %-20s%-10s%-16s%-10s%-12s%-10s%-10s\n", "Test Size", "Threads", "CPU Cycles", "Speedup",
+                    "Efficiency", "GB/s", "Of peak");
+            for (int i = 0; i < num_sizes; i++) {
+                double bytes = (double)sizes[i] * sizeof(uint64_t);
+                int suggested = 1;
+                for (int t = 1; t <= top; t++) {
+                    suggested = SCALING_CYCLES(p, k, i, t) < SCALING_CYCLES(p, k, i, suggested) ? t : suggested;
+                }
+                uint64_t best = SCALING_CYCLES(p, k, i, suggested);
+                for (int t = 1; t <= top; t++) {
+                    if (SCALING_CYCLES(p, k, i, t) <= best * 1.05) {
+                        suggested = t;
+                        break;
+                    }
+                }
+                for (int t = 1; t <= top; t++) {
+                    double speedup = (double)SCALING_CYCLES(p, k, i, 1) / SCALING_CYCLES(p, k, i, t);
+                    double gbs = bytes * tsc_hz / SCALING_CYCLES(p, k, i, t) / 1e9;
+                    char size_column[24] = "";
+                    if (t == 1) {
+                        snprintf(size_column, sizeof(size_column), "%" PRIu64, sizes[i]);
+                    }
+                    fprintf(log_output, "  %-20s%-10d%-16" PRIu64 "%-10.2f%-12.2f%-10.2f%5.1f%%%s\n", size_column, t,
+                            SCALING_CYCLES(p, k, i, t), speedup, speedup / t, gbs, 100 * gbs / peak, t == suggested ? "  <- fewest threads within 5% of the best" : "");
+                }
+            }
+        }
+    }
+    fprintf(log_output, "\nPeak STREAM triad bandwidth on this host: %.2f GB/s (arrays of %" PRIu64 " doubles); sizes that fit in a\n"
+            "cache can read faster than that\n", peak, triad_count);
+
+#undef SCALING_CYCLES
+    free(cycles);
+    for (int k = 0; k < num_parallel; k++) {
+        parallel[k]->parallel->serial_crossover = saved_crossover[k];
+    }
+    num_placement_cpus = 0;
+    pool_resize(saved_threads);
+    for (int a = 0; a < 3; a++) {
+        free(triad_arrays[a]);
+    }
+}
+
+// Function to run the NUMA kernel over freshly placed buffers and report the bandwidth each
+// node sustained; a node's time is its slowest worker's best chunk time
+void run_numa_test(uint64_t* sizes, int num_sizes) {
+    int width = perf_mode ? 329 : 241;
+    const char* name = "ParallelNumaUnroll4Scalar";
+    numa_chunk_func = Unroll4Scalar;
+    if (cpu_features & FEATURE_AVX2) {
+        name = "ParallelNumaSimd256x4";
+        numa_chunk_func = Simd256x4;
+    }
+
+    if (output_format == FORMAT_TEXT) {
+        printf("\nRunning NUMA first-touch tests for function: %s (%d threads over %d nodes)\n", name, pool.num_workers, num_numa_nodes);
+        print_text_header(width);
+    }
+
+    for (int i = 0; i < num_sizes; i++) {
+        uint64_t size = sizes[i];
+
+        // A fresh mapping per size, because placement follows the chunk split of this size
+        arena_map(size);
+        numa_base = arena.data;
+        pool_run(FirstTouchChunk, size, arena.data, sizeof(uint64_t), HUGE_PAGE_SIZE / sizeof(uint64_t));
+        for (int t = 0; t < pool.num_workers; t++) {
+            numa_worker_cycles[t] = UINT64_MAX;
+        }
+
+        test_record record = {.kernel = name, .size = size, .rel_error = NAN};
+        record.cycles = measure_cycles(ParallelNuma, arena.data, size, sizeof(uint64_t), &record.perf, &record.stats);
+        record.adds_per_cycle = (double)size / record.cycles;
+        record.result = ParallelNuma(size, arena.data);
+        add_record(&record);
+
+        if (output_format == FORMAT_TEXT) {
+            print_text_row(&record);
+        } else {
+            print_machine_record(&record);
+        }
+
+        int active = 0;
+        for (int n = 0; n < num_numa_nodes; n++) {
+            int threads = 0;
+            uint64_t bytes = 0, cycles = 0;
+            for (int t = 0; t < pool.num_workers; t++) {
+                if (numa_cpu_node[t % num_numa_cpus] == n && pool.tasks[t].count > 0) {
+                    threads++;
+                    bytes += pool.tasks[t].count * sizeof(uint64_t);
+                    cycles = numa_worker_cycles[t] > cycles ? numa_worker_cycles[t] : cycles;
+                }
+            }
+            active += threads;
+            char node_bytes[32];
+            format_bytes(bytes, node_bytes, sizeof(node_bytes));
+            fprintf(log_output, "    node %-4d%3d threads  %-12s", numa_node_ids[n], threads, node_bytes);
+            if (threads > 0) {
+                fprintf(log_output, "%8.2f GB/s\n", bytes * tsc_hz / cycles / 1e9);
+            } else {
+                fprintf(log_output, "%8s\n", "idle");
+            }
+        }
+        fprintf(log_output, "    total    %3d threads  %-12s%8.2f GB/s\n", active, "",
+                size * sizeof(uint64_t) * tsc_hz / record.cycles / 1e9);
+        if (atomic_load_explicit(&numa_placement_unverified, memory_order_relaxed)) {
+            fprintf(log_output, "    placement unverified: pages were not bound, the per-node split is by CPU only\n");
+        }
+        fflush(stdout);
+        arena_free();
+    }
+
+    if (output_format == FORMAT_TEXT) {
+        print_rule('=', width);
+    }
+}
+
+// Throughput of one kernel and size loaded from a saved report
+typedef struct {
+    char kernel[64];
+    uint64_t size;
+    double adds_per_cycle;
+} baseline_entry;
+
+// Function to find "key": in a JSON record line and return a pointer to its value
+static const char* json_value(const char* line, const char* key) {
+    char pattern[80];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* value = strstr(line, pattern);
+    if (value == NULL) {
+        return NULL;
+    }
+    value += strlen(pattern);
+    while (*value == ' ') {
+        value++;
+    }
+    return value;
+}
+
+// Function to return the index of a column in a CSV header line, -1 if it is missing
+static int csv_column(const char* header, const char* name) {
+    int column = 0;
+    size_t length = strlen(name);
+    for (const char* field = header;; column++) {
+        if (strncmp(field, name, length) == 0 && (field[length] == ',' || field[length] == '\n' || field[length] == '\0')) {
+            return column;
+        }
+        field = strchr(field, ',');
+        if (field == NULL) {
+            return -1;
+        }
+        field++;
+    }
+}
+
+// Function to copy the given CSV field of line into out
+static void csv_field(const char* line, int column, char* out, size_t out_size) {
+    for (; column > 0 && line != NULL; column--) {
+        line = strchr(line, ',');
+        line = line != NULL ? line + 1 : NULL;
+    }
+    size_t n = 0;
+    for (; line != NULL && line[n] != ',' && line[n] != '\n' && line[n] != '\0' && n + 1 < out_size; n++) {
+        out[n] = line[n];
+    }
+    out[n] = '\0';
+}
+
+// Function to load a report written with --format=json or --format=csv by any of the runners
+baseline_entry* load_baseline(const char* path, int* count) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open baseline %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    baseline_entry* entries = NULL;
+    int capacity = 0;
+    int kernel_column = -1, size_column = -1, throughput_column = -1;
+    char line[4096];
+    *count = 0;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        baseline_entry entry;
+        const char* kernel = json_value(line, "kernel");
+        if (kernel != NULL && *kernel == '"') {
+            const char* size = json_value(line, "size");
+            const char* throughput = json_value(line, "adds_per_cycle");
+            if (size == NULL || throughput == NULL) {
+                continue;
+            }
+            size_t length = strcspn(kernel + 1, "\"");
+            snprintf(entry.kernel, sizeof(entry.kernel), "%.*s", (int)length, kernel + 1);
+            entry.size = strtoull(size, NULL, 10);
+            entry.adds_per_cycle = strtod(throughput, NULL);
+        } else if (kernel_column < 0 && strncmp(line, "runner,", 7) == 0) {
+            kernel_column = csv_column(line, "kernel");
+            size_column = csv_column(line, "size");
+            throughput_column = csv_column(line, "adds_per_cycle");
+            continue;
+        } else if (kernel_column >= 0 && size_column >= 0 && throughput_column >= 0) {
+            char field[64];
+            csv_field(line, kernel_column, entry.kernel, sizeof(entry.kernel));
+            csv_field(line, size_column, field, sizeof(field));
+            entry.size = strtoull(field, NULL, 10);
+            csv_field(line, throughput_column, field, sizeof(field));
+            entry.adds_per_cycle = strtod(field, NULL);
+        } else {
+            continue;
+        }
+
+        if (*count == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            entries = realloc(entries, capacity * sizeof(baseline_entry));
+            if (entries == NULL) {
+                fprintf(stderr, "Error: Memory allocation failed for the baseline\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        entries[(*count)++] = entry;
+    }
+    fclose(file);
+
+    if (*count == 0) {
+        fprintf(stderr, "Error: %s contains no records, save one with --format=json or --format=csv\n", path);
+        exit(EXIT_FAILURE);
+    }
+    return entries;
+}
+
+// Function to compare this run against a baseline; returns the number of regressions, i.e. kernels
+// whose adds per cycle dropped by more than threshold percent
+int compare_baseline(const char* path, double threshold) {
+    int num_entries;
+    baseline_entry* entries = load_baseline(path, &num_entries);
+    int regressions = 0, compared = 0;
+
+    fprintf(log_output, "\nComparison against baseline %s (threshold %.1f%%):\n", path, threshold);
+    fprintf(log_output, "%-28s%-16s%-16s%-16s%-12s%s\n", "Kernel", "Test Size", "Baseline", "Current", "Change", "Status");
+    for (int r = 0; r < num_records; r++) {
+        const test_record* record = &records[r];
+        for (int e = 0; e < num_entries; e++) {
+            if (entries[e].size != record->size || strcmp(entries[e].kernel, record->kernel) != 0) {
+                continue;
+            }
+            double change = (record->adds_per_cycle / entries[e].adds_per_cycle - 1) * 100;
+            int regressed = change < -threshold;
+            regressions += regressed;
+            compared++;
+            fprintf(log_output, "%-28s%-16" PRIu64 "%-16.6f%-16.6f%+-12.1f%s\n", record->kernel, record->size,
+                    entries[e].adds_per_cycle, record->adds_per_cycle, change, regressed ? "REGRESSION" : "ok");
+            break;
+        }
+    }
+    fprintf(log_output, "%d of %d matching kernel/size pairs regressed\n", regressions, compared);
+
+    free(entries);
+    return regressions;
+}
+
+// Function to parse a byte count with an optional K, M or G (binary) suffix
+int parse_bytes(const char* text, uint64_t* bytes) {
+    char* suffix;
+    *bytes = strtoull(text, &suffix, 10);
+    switch (*suffix) {
+    case 'K': *bytes <<= 10; suffix++; break;
+    case 'M': *bytes <<= 20; suffix++; break;
+    case 'G': *bytes <<= 30; suffix++; break;
+    }
+    return suffix != text && (*suffix == '\0' || *suffix == ':' || *suffix == ',');
+}
+
+// Function to parse --sizes=5000,20000,... as element counts
+int parse_size_list(const char* text, uint64_t* sizes, int* num_sizes) {
+    *num_sizes = 0;
+    for (const char* item = text; *item != '\0'; item++) {
+        char* end;
+        uint64_t size = strtoull(item, &end, 10);
+        if (end == item || size == 0 || (*end != ',' && *end != '\0') || *num_sizes == MAX_SIZES) {
+            return 0;
+        }
+        sizes[(*num_sizes)++] = size;
+        item = end;
+        if (*item == '\0') {
+            break;
+        }
+    }
+    return *num_sizes > 0;
+}
+
+// Function to turn --sweep=MIN:MAX[:STEPS] (bytes, STEPS per octave) into a geometric list of element counts
+int parse_sweep(const char* text, uint64_t* sizes, int* num_sizes) {
+    uint64_t min_bytes, max_bytes, steps_per_octave = 8;
+    const char* max_text = strchr(text, ':');
+    if (max_text == NULL || !parse_bytes(text, &min_bytes) || !parse_bytes(max_text + 1, &max_bytes)) {
+        return 0;
+    }
+    const char* steps_text = strchr(max_text + 1, ':');
+    if (steps_text != NULL) {
+        steps_per_octave = strtoull(steps_text + 1, NULL, 10);
+    }
+    if (min_bytes < sizeof(uint64_t) || max_bytes < min_bytes || steps_per_octave == 0) {
+        return 0;
+    }
+
+    *num_sizes = 0;
+    for (uint64_t step = 0;; step++) {
+        double bytes = min_bytes * pow(2.0, (double)step / steps_per_octave);
+        if (bytes > max_bytes * (1 + 1e-9) || *num_sizes == MAX_SIZES) {
+            break;
+        }
+        uint64_t size = (uint64_t)(bytes / sizeof(uint64_t) + 0.5);
+        if (*num_sizes == 0 || size != sizes[*num_sizes - 1]) {
+            sizes[(*num_sizes)++] = size;
+        }
+    }
+    return 1;
+}
+
+void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --tsc-hz    print the TSC frequency in Hz and exit\n");
+    printf("  --perf      add core cycles, IPC, cache misses and backend stalls from perf_event_open\n");
+    printf("  --sizes=N,N,...          element counts to test (default 5000,20000,312500,6000000,25000000)\n");
+    printf("  --sweep=MIN:MAX[:STEPS]  geometric sweep over working-set bytes, K/M/G suffixes, STEPS per\n");
+    printf("                           octave (default 8), e.g. --sweep=1K:1G:8\n");
+    printf("  --runs=N    runs per kernel and size, the minimum is reported (default %d, %d with --adaptive)\n",
+           DEFAULT_RUNS, ADAPTIVE_MIN_RUNS);
+    printf("  --adaptive[=WIDTH]       keep sampling until the bootstrap 95%% CI of the median is narrower than\n");
+    printf("                           WIDTH times the median (default 0.01), at least --runs samples\n");
+    printf("  --max-runs=N             upper bound on the samples --adaptive takes (default %d)\n", DEFAULT_MAX_RUNS);
+    printf("  --warm      keep the input cached between runs (default)\n");
+    printf("  --cold[=flush|stream]    evict the input before every run with clflushopt over the buffer\n");
+    printf("                           (default) or by reading a scratch buffer twice the largest cache\n");
+    printf("  --prefetch-distance=BYTES  how far ahead the Simd256x4Prefetch kernels prefetch, K/M suffixes\n");
+    printf("                           (default %d)\n", DEFAULT_PREFETCH_DISTANCE);
+    printf("  --format=text|json|csv   report format; json and csv write one record per kernel and size to\n");
+    printf("                           stdout and the informational header to stderr\n");
+    printf("  --baseline=FILE          compare against a saved json or csv report and exit with status 3\n");
+    printf("                           if any kernel's adds per cycle dropped by more than the threshold\n");
+    printf("  --threshold=PCT          regression threshold for --baseline in percent (default %.0f)\n", DEFAULT_THRESHOLD);
+    printf("  --file=PATH              sum a file of native-endian uint64_t instead of the generated input;\n");
+    printf("                           it is mapped with MAP_POPULATE and every u64 kernel reads the mapping\n");
+    printf("                           directly, over the whole file unless --sizes or --sweep is given\n");
+    printf("  --stream    with --file, read the file through two O_DIRECT buffers while the best kernel sums\n");
+    printf("              the other one, for files larger than RAM (chosen automatically for those)\n");
+    printf("  --pipeline[=DEPTH]       overlap producing the input with summing it through a ring of DEPTH\n");
+    printf("                           L2-sized buffers (default %d, at most %d) and compare it with filling\n",
+           DEFAULT_PIPELINE_DEPTH, PIPELINE_MAX_DEPTH);
+    printf("                           the arena first; with --file, stream the file through the ring\n");
+    printf("  --prefix    build a blocked prefix-sum index over the input and compare random range queries\n");
+    printf("              and incremental rebuilds after point updates with rescanning each range\n");
+    printf("  --batch[=N] sum N arrays of each test size per call (default %d), looping over the best kernel\n",
+           DEFAULT_BATCH_ARRAYS);
+    printf("              and with the batched kernels that interleave four arrays through the accumulators;\n");
+    printf("              without --sizes the array sizes are 16,100,1000,5000\n");
+    printf("  --aggregate compute sum, min, max, count and sum of squares in one fused pass and in one pass\n");
+    printf("              per aggregate, to compare the bandwidth of both; works with --file\n");
+    printf("  --filter[=LIST]          sum only the elements in [2^20, 2^21) with the branchy, branchless,\n");
+    printf("                           AVX2 and AVX-512 filtered kernels, over inputs generated with each\n");
+    printf("                           selectivity in LIST: percentages, or random for a new one every %d\n", SELECTIVITY_BLOCK);
+    printf("                           elements (default 1,50,99,random)\n");
+    printf("  --packed    encode the input as bit-packed and as delta blocks of %d and sum the encodings\n", PACK_BLOCK);
+    printf("              with popcount kernels, reporting the compressed bytes read; works with --file\n");
+    printf("  --scaling[=N]            run the parallel kernels at 1 to N threads (default every CPU) with SMT\n");
+    printf("                           off and on placements, and report speedup, efficiency and GB/s against\n");
+    printf("                           a STREAM triad measured at the same thread counts\n");
+    printf("  --numa      spread the workers over the NUMA nodes, let each first-touch the slice it sums\n");
+    printf("              and report per-node bandwidth instead of running the kernel table; generates\n");
+    printf("              its input, so it can't be combined with --file\n");
+    printf("  --help      show this help\n");
+}
+
+int main(int argc, char** argv) {
+    static const struct option long_options[] = {
+        {"tsc-hz", no_argument, NULL, 't'},
+        {"perf", no_argument, NULL, 'p'},
+        {"sizes", required_argument, NULL, 's'},
+        {"sweep", required_argument, NULL, 'w'},
+        {"runs", required_argument, NULL, 'r'},
+        {"adaptive", optional_argument, NULL, 'a'},
+        {"max-runs", required_argument, NULL, 'm'},
+        {"warm", no_argument, NULL, 'W'},
+        {"cold", optional_argument, NULL, 'C'},
+        {"prefetch-distance", required_argument, NULL, 'P'},
+        {"format", required_argument, NULL, 'f'},
+        {"baseline", required_argument, NULL, 'b'},
+        {"threshold", required_argument, NULL, 'T'},
+        {"numa", no_argument, NULL, 'N'},
+        {"file", required_argument, NULL, 'F'},
+        {"stream", no_argument, NULL, 'S'},
+        {"pipeline", optional_argument, NULL, 'L'},
+        {"prefix", no_argument, NULL, 'X'},
+        {"batch", optional_argument, NULL, 'B'},
+        {"aggregate", no_argument, NULL, 'A'},
+        {"filter", optional_argument, NULL, 'Q'},
+        {"packed", no_argument, NULL, 'K'},
+        {"scaling", optional_argument, NULL, 'G'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    static uint64_t test_sizes[MAX_SIZES] = {5000, 20000, 312500, 6000000, 25000000};
+    int num_sizes = 5;
+    int print_tsc_only = 0;
+    int runs_given = 0;
+    int sizes_given = 0;
+    const char* input_file = NULL;
+    int stream_mode = 0;
+    int pipeline_depth = 0;
+    int prefix_mode = 0;
+    uint64_t batch_arrays = 0;
+    int aggregate_mode = 0;
+    int selectivities[MAX_SELECTIVITIES];
+    int num_selectivities = 0;
+    int packed_mode = 0;
+    int scaling_threads = -1;  // -1 off, 0 up to every CPU of the placement
+    const char* baseline_path = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    int option;
+    while ((option = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+        switch (option) {
+        case 't':
+            print_tsc_only = 1;
+            break;
+        case 'p':
+            perf_mode = 1;
+            break;
+        case 's':
+            if (!parse_size_list(optarg, test_sizes, &num_sizes)) {
+                fprintf(stderr, "Error: --sizes expects a comma-separated list of element counts\n");
+                return EXIT_FAILURE;
+            }
+            sizes_given = 1;
+            break;
+        case 'w':
+            if (!parse_sweep(optarg, test_sizes, &num_sizes)) {
+                fprintf(stderr, "Error: --sweep expects MIN:MAX[:STEPS] in bytes, e.g. 1K:1G:8\n");
+                return EXIT_FAILURE;
+            }
+            sizes_given = 1;
+            break;
+        case 'r':
+            num_runs = atoi(optarg);
+            if (num_runs < 1) {
+                fprintf(stderr, "Error: --runs must be at least 1\n");
+                return EXIT_FAILURE;
+            }
+            runs_given = 1;
+            break;
+        case 'a':
+            adaptive_ci_width = optarg != NULL ? atof(optarg) : 0.01;
+            if (adaptive_ci_width <= 0) {
+                fprintf(stderr, "Error: --adaptive expects a positive relative CI width, e.g. 0.01\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'm':
+            max_runs = atoi(optarg);
+            if (max_runs < 1) {
+                fprintf(stderr, "Error: --max-runs must be at least 1\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'W':
+            cache_mode = CACHE_WARM;
+            break;
+        case 'C':
+            if (optarg == NULL || strcmp(optarg, "flush") == 0) {
+                cache_mode = CACHE_COLD_FLUSH;
+            } else if (strcmp(optarg, "stream") == 0) {
+                cache_mode = CACHE_COLD_STREAM;
+            } else {
+                fprintf(stderr, "Error: --cold expects flush or stream\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'P': {
+            uint64_t bytes;
+            if (!parse_bytes(optarg, &bytes)) {
+                fprintf(stderr, "Error: --prefetch-distance expects a byte count, e.g. 2K\n");
+                return EXIT_FAILURE;
+            }
+            prefetch_distance = bytes / sizeof(uint64_t);
+            break;
+        }
+        case 'f':
+            if (strcmp(optarg, "text") == 0) {
+                output_format = FORMAT_TEXT;
+            } else if (strcmp(optarg, "json") == 0) {
+                output_format = FORMAT_JSON;
+            } else if (strcmp(optarg, "csv") == 0) {
+                output_format = FORMAT_CSV;
+            } else {
+                fprintf(stderr, "Error: --format expects text, json or csv\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'b':
+            baseline_path = optarg;
+            break;
+        case 'T':
+            threshold = atof(optarg);
+            if (threshold < 0) {
+                fprintf(stderr, "Error: --threshold must not be negative\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'N':
+            numa_mode = 1;
+            break;
+        case 'F':
+            input_file = optarg;
+            break;
+        case 'S':
+            stream_mode = 1;
+            break;
+        case 'B':
+            batch_arrays = optarg != NULL ? strtoull(optarg, NULL, 10) : DEFAULT_BATCH_ARRAYS;
+            if (batch_arrays == 0) {
+                fprintf(stderr, "Error: --batch needs a positive number of arrays\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'Q':
+            num_selectivities = parse_selectivities(optarg != NULL ? optarg : "1,50,99,random", selectivities);
+            if (num_selectivities <= 0) {
+                fprintf(stderr, "Error: --filter expects up to %d comma-separated percentages or random\n", MAX_SELECTIVITIES);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'G':
+            scaling_threads = optarg != NULL ? atoi(optarg) : 0;
+            if ((scaling_threads < 1 || scaling_threads > MAX_THREADS) && optarg != NULL) {
+                fprintf(stderr, "Error: --scaling needs a thread count from 1 to %d\n", MAX_THREADS);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'K':
+            packed_mode = 1;
+            break;
+        case 'A':
+            aggregate_mode = 1;
+            break;
+        case 'X':
+            prefix_mode = 1;
+            break;
+        case 'L':
+            pipeline_depth = optarg != NULL ? atoi(optarg) : DEFAULT_PIPELINE_DEPTH;
+            if (pipeline_depth < 2 || pipeline_depth > PIPELINE_MAX_DEPTH) {
+                fprintf(stderr, "Error: --pipeline needs a depth from 2 to %d\n", PIPELINE_MAX_DEPTH);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (adaptive_ci_width > 0 && !runs_given) {
+        num_runs = ADAPTIVE_MIN_RUNS;
+    }
+
+    log_output = output_format == FORMAT_TEXT ? stdout : stderr;
+
+    calibrate_tsc();
+    if (print_tsc_only) {
+        printf("%.0f\n", tsc_hz);
+        return 0;
+    }
+
+    long online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = online_cpus > 0 ? (int)online_cpus : 1;
+    const char* threads_env = getenv("SUM_THREADS");
+    if (threads_env != NULL) {
+        num_threads = atoi(threads_env);
+    }
+    if (num_threads < 1 || num_threads > MAX_THREADS) {
+        fprintf(stderr, "Error: SUM_THREADS must be between 1 and %d\n", MAX_THREADS);
+        return EXIT_FAILURE;
+    }
+    if (perf_mode && !perf_open()) {
+        fprintf(stderr, "Warning: perf_event_open failed, check /proc/sys/kernel/perf_event_paranoid; continuing without --perf\n");
+        perf_mode = 0;
+    }
+
+    detect_caches();
+    measure_timer_overhead();
+
+    if (stream_mode && input_file == NULL) {
+        fprintf(stderr, "Error: --stream needs --file\n");
+        return EXIT_FAILURE;
+    }
+    if (scaling_threads >= 0 && numa_mode) {
+        fprintf(stderr, "Error: --scaling picks its own placements and can't be combined with --numa\n");
+        return EXIT_FAILURE;
+    }
+    if (numa_mode && input_file != NULL) {
+        fprintf(stderr, "Error: --numa first-touches a generated arena per node and can't use --file\n");
+        return EXIT_FAILURE;
+    }
+    if (scaling_threads >= 0) {
+        detect_smt();
+    }
+    if (num_selectivities > 0 && input_file != NULL) {
+        fprintf(stderr, "Error: --filter generates inputs of known selectivity and can't use --file\n");
+        return EXIT_FAILURE;
+    }
+    if (batch_arrays > 0 && input_file != NULL) {
+        fprintf(stderr, "Error: --batch lays its arrays out in the generated arena and can't use --file\n");
+        return EXIT_FAILURE;
+    }
+    if (batch_arrays > 0 && !sizes_given) {
+        static const uint64_t batch_sizes[] = {16, 100, 1000, 5000};
+        num_sizes = sizeof(batch_sizes) / sizeof(batch_sizes[0]);
+        memcpy(test_sizes, batch_sizes, sizeof(batch_sizes));
+    }
+    if (prefix_mode && input_file != NULL) {
+        fprintf(stderr, "Error: --prefix writes point updates into the input and needs the generated arena\n");
+        return EXIT_FAILURE;
+    }
+    if (pipeline_depth > 0 && input_file != NULL) {
+        stream_mode = 1;
+    }
+    struct stat file_stat;
+    if (input_file != NULL && !stream_mode && stat(input_file, &file_stat) == 0 &&
+        (double)file_stat.st_size > (double)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE)) {
+        fprintf(stderr, "Note: %s is larger than RAM, streaming it instead of mapping it\n", input_file);
+        stream_mode = 1;
+    }
+
+    uint64_t map_cycles = 0;
+    if (numa_mode) {
+        detect_numa();
+    } else if (input_file != NULL && !stream_mode) {
+        uint64_t start = read_tsc_begin();
+        arena_map_file(input_file);
+        map_cycles = read_tsc_end() - start;
+        if (!sizes_given) {
+            test_sizes[0] = arena.capacity;
+            num_sizes = 1;
+        }
+        for (int i = 0; i < num_sizes; i++) {
+            if (test_sizes[i] > arena.capacity) {
+                fprintf(stderr, "Error: size %" PRIu64 " exceeds the %" PRIu64 " elements in %s\n", test_sizes[i], arena.capacity, input_file);
+                return EXIT_FAILURE;
+            }
+        }
+    } else if (stream_mode) {
+        arena_init(CALIBRATION_SIZE);
+    } else {
+        uint64_t arena_size = CALIBRATION_SIZE;
+        for (int i = 0; i < num_sizes; i++) {
+            uint64_t needed = test_sizes[i] * (batch_arrays > 0 ? batch_arrays : 1);
+            arena_size = needed > arena_size ? needed : arena_size;
+        }
+        arena_init(arena_size);
+    }
+
+    if (cache_mode == CACHE_COLD_STREAM) {
+        uint64_t largest_cache = num_caches > 0 ? caches[num_caches - 1].size : (64ull << 20);
+        scratch_count = 2 * largest_cache / sizeof(uint64_t);
+        scratch_data = malloc(scratch_count * sizeof(uint64_t));
+        if (scratch_data == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed for the eviction buffer\n");
+            return EXIT_FAILURE;
+        }
+        for (uint64_t j = 0; j < scratch_count; j++) {
+            scratch_data[j] = j;
+        }
+    }
+    pool_init(1);  // The benchmark owns its main thread, so pin it like the workers
+    detect_host();
+    fprintf(log_output, "Build: %s (%s, %s)\n", host.build, host.compiler, host.cflags);
+    fprintf(log_output, "TSC frequency: %.0f Hz (%s)\n", tsc_hz, tsc_source);
+    fprintf(log_output, "Timer overhead: %" PRIu64 " cycles (subtracted from every measurement)\n", timer_overhead);
+    fprintf(log_output, "Caches:");
+    for (int i = 0; i < num_caches; i++) {
+        char size[32];
+        format_bytes(caches[i].size, size, sizeof(size));
+        fprintf(log_output, " %s %s%s", caches[i].name, size, i + 1 < num_caches ? "," : "");
+    }
+    fprintf(log_output, num_caches == 0 ? " not detected\n" : "\n");
+    if (adaptive_ci_width > 0) {
+        fprintf(log_output, "Runs per test: adaptive, %d to %d until the median 95%% CI is within %.2f%% of the median\n",
+               num_runs, max_runs > num_runs ? max_runs : num_runs, adaptive_ci_width * 100);
+    } else {
+        fprintf(log_output, "Runs per test: %d\n", num_runs);
+    }
+    if (numa_mode) {
+        fprintf(log_output, "NUMA nodes:");
+        for (int n = 0; n < num_numa_nodes; n++) {
+            int threads = 0;
+            for (int t = 0; t < num_threads; t++) {
+                threads += numa_cpu_node[t % num_numa_cpus] == n;
+            }
+            fprintf(log_output, " node%d %d threads%s", numa_node_ids[n], threads, n + 1 < num_numa_nodes ? "," : "\n");
+        }
+        fprintf(log_output, "Input: mapped per test size, each worker first-touches its 2 MiB aligned slice\n");
+    } else if (input_file != NULL && !stream_mode) {
+        char file_bytes[32];
+        format_bytes(arena.mapped_bytes, file_bytes, sizeof(file_bytes));
+        fprintf(log_output, "Input file: %s, %s, %" PRIu64 " elements, %s in %.3f s\n",
+                input_file, file_bytes, arena.capacity, arena.backing, map_cycles / tsc_hz);
+    } else {
+        char arena_bytes[32];
+        format_bytes(arena.mapped_bytes, arena_bytes, sizeof(arena_bytes));
+        fprintf(log_output, "Input arena: %s, 2 MiB aligned, %s\n", arena_bytes, arena.backing);
+    }
+    if (cache_mode == CACHE_WARM) {
+        fprintf(log_output, "Cache state: warm (runs back to back over the same buffer)\n");
+    } else if (cache_mode == CACHE_COLD_FLUSH) {
+        fprintf(log_output, "Cache state: cold (%s over the input before every run)\n", has_clflushopt ? "clflushopt" : "clflush");
+    } else {
+        char scratch_bytes[32];
+        format_bytes(scratch_count * sizeof(uint64_t), scratch_bytes, sizeof(scratch_bytes));
+        fprintf(log_output, "Cache state: cold (reading a %s scratch buffer before every run)\n", scratch_bytes);
+    }
+    fprintf(log_output, "Prefetch distance: %" PRIu64 " bytes\n", prefetch_distance * sizeof(uint64_t));
+    fprintf(log_output, "Parallel kernels use %d threads\n", num_threads);
+    if (numa_mode) {
+        print_report_header();
+        run_numa_test(test_sizes, num_sizes);
+        print_report_footer();
+        int regressions = baseline_path != NULL ? compare_baseline(baseline_path, threshold) : 0;
+        pool_shutdown();
+        free(scratch_data);
+        free(samples);
+        free(scratch_samples);
+        free(records);
+        return regressions > 0 ? 3 : 0;
+    }
+
+    for (int k = 0; k < num_kernels; k++) {
+        if (kernels[k].parallel != NULL && kernel_supported(&kernels[k])) {
+            calibrate_crossover(kernels[k].parallel, kernels[k].func);
+            print_crossover(kernels[k].name, kernels[k].parallel);
+        }
+    }
+
+    if (input_file != NULL && !stream_mode) {
+        // The first pass pays for whatever MAP_POPULATE had to read from storage
+        const kernel_entry* kernel = best_kernel(arena.capacity);
+        uint64_t start = read_tsc_begin();
+        kernel->func(arena.capacity, arena.data);
+        uint64_t pass_cycles = read_tsc_end() - start;
+        fprintf(log_output, "End to end: mapping plus one %s pass in %.3f s, %.2f GB/s, %.0f%% of it spent mapping\n",
+                kernel->name, (map_cycles + pass_cycles) / tsc_hz,
+                arena.capacity * sizeof(uint64_t) * tsc_hz / (map_cycles + pass_cycles) / 1e9,
+                100.0 * map_cycles / (map_cycles + pass_cycles));
+    }
+
+    print_report_header();
+    if (stream_mode) {
+        if (pipeline_depth > 0) {
+            run_stream_test(input_file, best_kernel(l2_chunk_bytes() / sizeof(uint64_t)), pipeline_depth, l2_chunk_bytes());
+        } else {
+            run_stream_test(input_file, best_kernel(STREAM_CHUNK / sizeof(uint64_t)), 2, STREAM_CHUNK);
+        }
+    } else if (pipeline_depth > 0) {
+        run_pipeline_test(test_sizes, num_sizes, pipeline_depth, l2_chunk_bytes());
+    } else if (prefix_mode) {
+        run_prefix_test(test_sizes, num_sizes);
+    } else if (batch_arrays > 0) {
+        run_batch_test(test_sizes, num_sizes, batch_arrays);
+    } else if (aggregate_mode) {
+        run_aggregate_test(test_sizes, num_sizes);
+    } else if (num_selectivities > 0) {
+        run_filter_test(test_sizes, num_sizes, selectivities, num_selectivities);
+    } else if (packed_mode) {
+        run_packed_test(test_sizes, num_sizes);
+    } else if (scaling_threads >= 0) {
+        run_scaling_test(test_sizes, num_sizes, scaling_threads);
+    }
+    int table_mode = !stream_mode && pipeline_depth == 0 && !prefix_mode && batch_arrays == 0 && !aggregate_mode &&
+                     num_selectivities == 0 && !packed_mode && scaling_threads < 0;
+    for (int k = 0; k < num_kernels && table_mode; k++) {
+        if (!kernel_supported(&kernels[k])) {
+            fprintf(log_output, "\nSkipping %s: the CPU does not support", kernels[k].name);
+            print_missing_features(kernels[k].required_features & ~cpu_features);
+            fprintf(log_output, "\n");
+        } else if (input_file != NULL && kernels[k].elem_type != ELEM_U64) {
+            fprintf(log_output, "\nSkipping %s: the input file holds u64 elements\n", kernels[k].name);
+        } else {
+            run_test(&kernels[k], test_sizes, num_sizes);
+        }
+    }
+
+    print_report_footer();
+
+    if (table_mode) {
+        fprintf(log_output, "\nBest available kernel per test size:\n");
+        for (int i = 0; i < num_sizes; i++) {
+            fprintf(log_output, "  %-20" PRIu64 "%s\n", test_sizes[i], best_kernel(test_sizes[i])->name);
+        }
+    }
+
+    int regressions = baseline_path != NULL ? compare_baseline(baseline_path, threshold) : 0;
+
+    pool_shutdown();
+    arena_free();
+    free(scratch_data);
+    free(samples);
+    free(scratch_samples);
+    free(records);
+    return regressions > 0 ? 3 : 0;
+}
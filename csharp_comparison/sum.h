@@ -0,0 +1,41 @@
+// Summation kernels for uint64_t arrays, built as libsum.a and libsum.so by the Makefile. Most
+// callers only need sum_u64:
+//
+//   #include "sum.h"
+//   uint64_t total = sum_u64(data, count);
+//
+// This is the whole public API; libsum.so exports nothing else. The kernel registry, the worker
+// pool and the rest of what the benchmark in sum.c drives directly live in sum_internal.h.
+
+#ifndef SUM_H
+#define SUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// libsum.o is built with -fvisibility=hidden, so only what carries this is exported
+#define SUM_API __attribute__((visibility("default")))
+
+// Function to sum count elements with the fastest serial kernel this CPU supports, chosen from the
+// registry once when the library is loaded; the sum wraps modulo 2^64
+SUM_API uint64_t sum_u64(const uint64_t* data, size_t count);
+
+// Function to return the registry name of the kernel sum_u64 dispatches to
+SUM_API const char* sum_u64_kernel(void);
+
+// Function to sum count elements without wrapping: returns the low 64 bits of the exact sum and
+// stores the high 64 bits in *high, using the widest checked kernel this CPU supports
+SUM_API uint64_t sum_u64_wide(const uint64_t* data, size_t count, uint64_t* high);
+
+// The clock every runner reports in, so the C#, Python and C numbers compare directly:
+// sum_tsc_begin waits for earlier instructions, sum_tsc_end for the timed ones to finish
+SUM_API uint64_t sum_tsc_begin(void);
+SUM_API uint64_t sum_tsc_end(void);
+SUM_API double sum_tsc_hz(void);
+
+// Function to time the registry kernel called name on count elements of data with the clock above,
+// see libsum.c; returns 0 when there is no such u64 kernel or the CPU lacks its features, and
+// stores the sum in *result unless result is NULL
+SUM_API uint64_t sum_measure_cycles(const char* name, const uint64_t* data, size_t count, int runs, uint64_t* result);
+
+#endif
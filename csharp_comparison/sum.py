@@ -1,18 +1,60 @@
-import time
+import argparse
+import csv
+import ctypes
+import json
+import os
+import platform
+import sys
 import numpy
 
-# Assumed CPU frequency in cycles per second
-CPU_FREQUENCY_HZ = 4_400_000_000  # 4.4 GHz for All-Core Turbo
 NUM_RUNS = 2  # Number of times to run each test
+C_RUNS = 100  # Runs of the C kernels and the FFI calls, which are fast enough for the C harness's default
+TIMER_OVERHEAD_RUNS = 10000  # Empty TSC read pairs used to estimate the timer overhead
 
+# C kernels timed inside libsum on the same buffer as the Python loops; the ones this CPU can't run are skipped
+C_KERNELS = ["SingleScalar", "Unroll2Scalar", "Unroll4Scalar", "Simd256", "Simd256x4", "Simd512x4", "SumU64"]
+
+# libsum.so from the Makefile supplies the clock every runner reports in, the C kernels, and sum_u64 as the
+# FFI call whose overhead is charted
+LIBRARY_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libsum.so")
+U64_POINTER = ctypes.POINTER(ctypes.c_uint64)
+
+def load_library():
+    library = ctypes.CDLL(LIBRARY_PATH)
+    library.sum_tsc_begin.restype = ctypes.c_uint64
+    library.sum_tsc_begin.argtypes = []
+    library.sum_tsc_end.restype = ctypes.c_uint64
+    library.sum_tsc_end.argtypes = []
+    library.sum_tsc_hz.restype = ctypes.c_double
+    library.sum_tsc_hz.argtypes = []
+    library.sum_u64.restype = ctypes.c_uint64
+    library.sum_u64.argtypes = [U64_POINTER, ctypes.c_size_t]
+    library.sum_measure_cycles.restype = ctypes.c_uint64
+    library.sum_measure_cycles.argtypes = [ctypes.c_char_p, U64_POINTER, ctypes.c_size_t, ctypes.c_int, U64_POINTER]
+    return library
+
+library = None  # Set in main, the kernels below reach the C side through it
+CPU_FREQUENCY_HZ = 0.0  # TSC ticks per second, from sum_tsc_hz
+timer_overhead = 0  # Cycles of an empty sum_tsc_begin/sum_tsc_end pair through ctypes
+
+def pinned_input(size):
+    # numpy owns the buffer and ctypes gets its address, so the C kernels read the same memory without a copy
+    input_data = numpy.arange(size, dtype=numpy.uint64)
+    return input_data, input_data.ctypes.data_as(U64_POINTER)
+
+# Columns shared with the C and C# runners, so `./sum --baseline` can read any of the reports
+CSV_COLUMNS = ["runner", "kernel", "size", "result", "time_s", "min_cycles", "adds_per_cycle", "runs",
+               "cpu_model", "tsc_hz", "compiler", "cflags"]
+
+# The Python loops start from a numpy.uint64 so the sum stays an unsigned 64-bit integer
 def SingleScalar(count, input_data):
-    total_sum = 0
+    total_sum = numpy.uint64(0)
     for i in range(count):
         total_sum += input_data[i]
     return total_sum
 
 def SingleScalarNoRange(_, input_data):
-    total_sum = 0
+    total_sum = numpy.uint64(0)
     for i in input_data:
         total_sum += i
     return total_sum
@@ -21,39 +63,141 @@ def NumpySum(_, input_data):
     return numpy.sum(input_data)
 
 def BuiltinSum(_, input_data):
-    return sum(input_data)
+    return sum(input_data, numpy.uint64(0))
+
+# sum_u64 through ctypes, timed from Python so the cycles include the call and the argument conversion
+def FfiSumU64(count, input_data):
+    return library.sum_u64(input_data.ctypes.data_as(U64_POINTER), count)
+
+def cpu_model():
+    try:
+        with open("/proc/cpuinfo") as cpuinfo:
+            for line in cpuinfo:
+                if line.startswith("model name"):
+                    return line.split(":", 1)[1].strip().replace(",", " ")
+    except OSError:
+        pass
+    return platform.processor() or "unknown"
+
+def host_info():
+    return {"cpu_model": cpu_model(), "tsc_hz": round(CPU_FREQUENCY_HZ),
+            "compiler": f"python {platform.python_version()}", "cflags": platform.python_implementation()}
+
+def measure_timer_overhead():
+    min_cycles = None
+    for _ in range(TIMER_OVERHEAD_RUNS):
+        start = library.sum_tsc_begin()
+        cycles = library.sum_tsc_end() - start
+        min_cycles = cycles if min_cycles is None else min(min_cycles, cycles)
+    return min_cycles
+
+def measure_cycles(func, size, input_data, runs=NUM_RUNS):
+    min_cycles = None
+    result = None
+    # Run the function multiple times and keep the minimum
+    for _ in range(runs):
+        start = library.sum_tsc_begin()
+        result = func(size, input_data)
+        cycles = library.sum_tsc_end() - start
+        cycles = cycles - timer_overhead if cycles > timer_overhead else 1
+        min_cycles = cycles if min_cycles is None else min(min_cycles, cycles)
+    return min_cycles, result
 
-def run_test(func, sizes):
-    print(f"\nRunning tests for function: {func.__name__}")
+def print_header(name):
+    print(f"\nRunning tests for function: {name}")
     print("=" * 100)
     print(f"{'Test Size':<20}{'Result':<25}{'Time Taken (s)':<20}{'CPU Cycles':<15}{'Adds per Cycle':<15}")
     print("-" * 100)
 
+def add_result(name, size, result, cycles, runs, output_format, records):
+    elapsed_time_s = cycles / CPU_FREQUENCY_HZ
+    adds_per_cycle = size / cycles
+    if output_format == "text":
+        print(f"{size:<20}{int(result):<25}{elapsed_time_s:<20.6f}{cycles:<15}{adds_per_cycle:<15.6f}")
+    else:
+        records.append({"runner": "python", "kernel": name, "size": size, "result": int(result),
+                        "time_s": elapsed_time_s, "min_cycles": cycles,
+                        "adds_per_cycle": round(adds_per_cycle, 6), "runs": runs})
+
+def run_test(func, sizes, output_format, records, runs=NUM_RUNS):
+    if output_format == "text":
+        print_header(func.__name__)
+
     for size in sizes:
-        input_data = list(range(size))
-        min_elapsed_time_s = float("inf")  # Initialize with infinity
-        result = None
-
-        # Run the function multiple times and keep the minimum time
-        for _ in range(NUM_RUNS):
-            start_time = time.perf_counter_ns()
-            result = func(size, input_data)
-            end_time = time.perf_counter_ns()
-            elapsed_time_s = (end_time - start_time) / 1_000_000_000  # Convert ns to seconds
-            if elapsed_time_s < min_elapsed_time_s:
-                min_elapsed_time_s = elapsed_time_s
-
-        # Calculate CPU cycles and adds per cycle based on the fastest time
-        cpu_cycles = min_elapsed_time_s * CPU_FREQUENCY_HZ
-        adds_per_cycle = size / cpu_cycles
-
-        # Print results for this test size
-        print(f"{size:<20}{result:<25}{min_elapsed_time_s:<20.6f}{int(cpu_cycles):<15}{adds_per_cycle:<15.6f}")
-    print("=" * 100)
+        input_data, _ = pinned_input(size)
+        cycles, result = measure_cycles(func, size, input_data, runs)
+        add_result(func.__name__, size, result, cycles, runs, output_format, records)
+
+    if output_format == "text":
+        print("=" * 100)
+
+# Time a C kernel inside libsum on the numpy buffer, skipped when the CPU can't run it
+def run_c_test(kernel, sizes, output_format, records):
+    header = False
+    for size in sizes:
+        _, pointer = pinned_input(size)
+        result = ctypes.c_uint64()
+        cycles = library.sum_measure_cycles(kernel.encode(), pointer, size, C_RUNS, ctypes.byref(result))
+        if cycles == 0:
+            return
+        if output_format == "text" and not header:
+            print_header(f"C:{kernel}")
+            header = True
+        add_result(f"C:{kernel}", size, result.value, cycles, C_RUNS, output_format, records)
+
+    if header:
+        print("=" * 100)
+
+# Chart what calling into C costs: sum_u64 timed from Python across ctypes against the same call timed
+# inside the library, on one buffer, with one clock
+def print_ffi_overhead(sizes, log):
+    print("\nFFI overhead of sum_u64 (ctypes, cycles):", file=log)
+    print(f"{'Test Size':<20}{'In C':<15}{'From Python':<15}{'Overhead':<15}", file=log)
+    for size in [0] + sizes:
+        input_data, pointer = pinned_input(max(size, 1))
+        in_c = library.sum_measure_cycles(b"SumU64", pointer, size, C_RUNS, None)
+        from_python, _ = measure_cycles(FfiSumU64, size, input_data, C_RUNS)
+        print(f"{size:<20}{in_c:<15}{from_python:<15}{from_python - in_c:<15}", file=log)
+
+def print_records(output_format, records):
+    host = host_info()
+    if output_format == "json":
+        # Same layout as the C harness: one record per line
+        print('{"runner": "python", "host": ' + json.dumps(host) + ",")
+        print('"results": [')
+        print(",\n".join("  " + json.dumps(record) for record in records))
+        print("]}")
+    elif output_format == "csv":
+        writer = csv.DictWriter(sys.stdout, fieldnames=CSV_COLUMNS, lineterminator="\n")
+        writer.writeheader()
+        for record in records:
+            writer.writerow({**record, **host})
 
 if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--format", choices=["text", "json", "csv"], default="text",
+                        help="json and csv write one record per kernel and size to stdout")
+    args = parser.parse_args()
+
+    # Keep stdout machine-readable for json and csv
+    log = sys.stdout if args.format == "text" else sys.stderr
+    try:
+        library = load_library()
+    except OSError:
+        sys.exit(f"Error: {LIBRARY_PATH} not found, build it with `make libsum.so`")
+    CPU_FREQUENCY_HZ = library.sum_tsc_hz()
+    timer_overhead = measure_timer_overhead()
+    print(f"TSC frequency: {CPU_FREQUENCY_HZ:.0f} Hz (from libsum)", file=log)
+    print(f"Timer overhead: {timer_overhead} cycles (subtracted from every measurement)", file=log)
+
+    records = []
     test_sizes = [5000, 20000, 312500, 6000000, 25000000]
-    run_test(SingleScalar, test_sizes)
-    run_test(SingleScalarNoRange, test_sizes)
-    run_test(NumpySum, test_sizes)
-    run_test(BuiltinSum, test_sizes)
+    run_test(SingleScalar, test_sizes, args.format, records)
+    run_test(SingleScalarNoRange, test_sizes, args.format, records)
+    run_test(NumpySum, test_sizes, args.format, records)
+    run_test(BuiltinSum, test_sizes, args.format, records)
+    for kernel in C_KERNELS:
+        run_c_test(kernel, test_sizes, args.format, records)
+    run_test(FfiSumU64, test_sizes, args.format, records, C_RUNS)
+    print_ffi_overhead(test_sizes, log)
+    print_records(args.format, records)
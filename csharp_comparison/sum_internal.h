@@ -0,0 +1,292 @@
+// Library internals shared by libsum.c and the benchmark in sum.c, which links the archive or the
+// sources directly. Every kernel keeps the signature uint64_t kernel(uint64_t count, uint64_t*
+// input_data) and checks nothing, the caller picks one its CPU supports through kernel_supported.
+// None of this is exported from libsum.so or installed with sum.h.
+
+#ifndef SUM_INTERNAL_H
+#define SUM_INTERNAL_H
+
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <immintrin.h>
+
+#include "sum.h"
+
+#define DEFAULT_PREFETCH_DISTANCE 1024  // Bytes ahead of the loads the prefetching kernels request, see --prefetch-distance
+#define CACHE_LINE_SIZE 64  // Partial sums are padded to this size so threads never share a line
+#define MAX_THREADS 256  // Upper bound for the SUM_THREADS environment variable
+#define SPIN_LIMIT 4096  // Spins on the pool barrier before a waiting thread yields its CPU
+
+extern int num_threads;  // Workers pool_init starts, the calling thread included
+extern uint64_t prefetch_distance;  // In elements, read by the Simd256x4Prefetch kernels
+
+// Element types the generated kernel family sums. A typed kernel keeps the common kernel
+// signature: input_data points at count elements of its type, and float kernels return the
+// bit pattern of their double result so the reports can format it
+enum {
+    ELEM_U64,
+    ELEM_U8,
+    ELEM_U16,
+    ELEM_U32,
+    ELEM_F32,
+    ELEM_F64,
+};
+
+typedef struct {
+    const char* name;
+    size_t size;
+    int is_float;
+} element_type;
+
+static inline uint64_t double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline double bits_double(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Function to read the TSC once all earlier instructions have completed
+static inline uint64_t read_tsc_begin(void) {
+    uint32_t low, high;
+    asm volatile ("lfence\n\trdtsc" : "=a" (low), "=d" (high) : : "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+// Function to read the TSC after the kernel has completed, before any later instruction starts
+static inline uint64_t read_tsc_end(void) {
+    uint32_t low, high, aux;
+    asm volatile ("rdtscp\n\tlfence" : "=a" (low), "=d" (high), "=c" (aux) : : "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+// Per-thread work description, aligned so every partial sum lives on its own cache line
+typedef struct {
+    uint64_t (*chunk_func)(uint64_t, uint64_t*);
+    uint64_t count;
+    uint64_t* input_data;
+    uint64_t partial_sum;
+    uint64_t cycles;  // TSC ticks the worker spent on its chunk in the last round
+} __attribute__((aligned(CACHE_LINE_SIZE))) thread_task;
+
+// A parallel kernel is a chunk function plus the size below which it is faster to stay serial
+typedef struct {
+    uint64_t (*chunk_func)(uint64_t, uint64_t*);
+    uint64_t serial_crossover;
+} parallel_kernel;
+
+// Persistent worker pool; the dispatcher bumps generation to start a round and
+// waits for pending to drop to zero, so no locks or thread creation on the hot path
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t generation;
+    _Alignas(CACHE_LINE_SIZE) atomic_int pending;
+    _Alignas(CACHE_LINE_SIZE) atomic_int shutdown;
+    int num_workers;
+    int pin_caller;  // Whether pool_init pinned the calling thread as worker 0
+    pthread_t threads[MAX_THREADS];
+    thread_task tasks[MAX_THREADS];
+} worker_pool;
+
+#define MAX_NUMA_NODES 64  // Upper bound for the nodes detect_numa spreads the workers over
+
+// Function to back off while waiting on the pool barrier, spinning first and yielding later
+static inline void spin_wait(int* spins) {
+    if (++*spins < SPIN_LIMIT) {
+        _mm_pause();
+    } else {
+        sched_yield();
+    }
+}
+
+// Batched sums: results[s] is the sum of the count elements at spans[s].data. Each group of four
+// arrays is interleaved, one accumulator per array, so the four dependency chains overlap the way
+// the four accumulators of the x4 kernels do, and one transposed reduction finishes all of them
+typedef struct {
+    uint64_t* data;
+    uint64_t count;
+} sum_span;
+
+#define BATCH_GROUP 4
+
+// Fused aggregates. One pass fills every field the flags ask for; the separate-pass variants run
+// the same code once per flag, which is what calling one kernel per aggregate costs
+typedef struct {
+    uint64_t sum;  // Wraps modulo 2^64 like the sum kernels
+    uint64_t min;  // UINT64_MAX for an empty input
+    uint64_t max;
+    uint64_t count;
+    unsigned __int128 sum_squares;  // Exact
+} aggregate_stats;
+
+enum {
+    AGG_SUM = 1 << 0,
+    AGG_MIN = 1 << 1,
+    AGG_MAX = 1 << 2,
+    AGG_SQUARES = 1 << 3,
+    AGG_ALL = AGG_SUM | AGG_MIN | AGG_MAX | AGG_SQUARES,
+};
+
+// Compressed input written by pack_input and read by the Packed kernels, see libsum.c for the layout
+#define PACK_BLOCK 128  // Elements per encoded block
+#define PACK_WORDS 2  // 64-bit words per bit plane
+
+enum {
+    PACK_FOR,
+    PACK_DELTA,
+};
+
+// ISA extensions a kernel may require, detected once at startup
+enum {
+    FEATURE_SSE2 = 1 << 0,
+    FEATURE_AVX2 = 1 << 1,
+    FEATURE_AVX512F = 1 << 2,
+    FEATURE_AVX512VPOPCNTDQ = 1 << 3,
+};
+
+// Kernel registry entry; priority orders kernels from slowest to fastest for best_kernel,
+// parallel kernels are only picked from their measured serial crossover upwards
+typedef struct {
+    const char* name;
+    uint64_t (*func)(uint64_t, uint64_t*);
+    uint32_t required_features;
+    int priority;
+    parallel_kernel* parallel;
+    int elem_type;  // ELEM_* the kernel reads
+} kernel_entry;
+
+// A checked kernel of the main registry and its wide form, which also stores the high word
+typedef struct {
+    uint64_t (*func)(uint64_t, uint64_t*);
+    uint64_t (*wide)(uint64_t, uint64_t*, uint64_t*);
+    uint32_t required_features;
+} wide_entry;
+
+// Batched kernel registry, run by --batch next to a loop over the best single-array kernel
+typedef struct {
+    const char* name;
+    void (*func)(const sum_span*, uint64_t, uint64_t*);
+    uint32_t required_features;
+} batch_entry;
+
+// Aggregate kernel registry, run by --aggregate as fused and separate-pass pairs
+typedef struct {
+    const char* name;
+    void (*fused)(uint64_t, const uint64_t*, aggregate_stats*);
+    void (*separate)(uint64_t, const uint64_t*, aggregate_stats*);
+    uint32_t required_features;
+} aggregate_entry;
+
+// Filtered sum kernel registry, run by --filter; func adds the elements in [lo, hi)
+typedef struct {
+    const char* name;
+    uint64_t (*func)(uint64_t, uint64_t*, uint64_t, uint64_t);
+    uint32_t required_features;
+} filter_entry;
+
+// Compressed-input kernels, run by --packed; input_data points at the encoding, not the values
+typedef struct {
+    kernel_entry kernel;
+    int encoding;  // PACK_* the kernel reads
+} packed_entry;
+
+#define PREFIX_BLOCK 256  // Elements per block of the prefix-sum index, a multiple of 4 for the AVX2 scan
+
+// Blocked prefix-sum index over a uint64_t buffer it does not own. local[i] is the inclusive sum of
+// i's block up to i and block_prefix[b] the sum of every block before b, so any prefix is one add and
+// any range two. Sums wrap modulo 2^64 like the kernels, which keeps the subtraction exact. Point
+// updates go through prefix_update and mark the block dirty; only dirty blocks are rescanned and only
+// the block_prefix entries from the first dirty block onwards are redone.
+typedef struct {
+    uint64_t* data;
+    uint64_t count;
+    uint64_t num_blocks;
+    uint64_t* local;
+    uint64_t* block_sums;  // Each block's own total, contiguous so redoing block_prefix streams
+    uint64_t* block_prefix;  // num_blocks + 1 entries, the last is the total
+    uint64_t* dirty;  // One bit per block
+    uint64_t first_dirty;  // num_blocks when the index is clean
+} prefix_index;
+
+extern const element_type element_types[];
+
+extern parallel_kernel parallel_unroll4_scalar;
+extern parallel_kernel parallel_unroll4_simd256;
+extern worker_pool pool;
+
+extern int numa_mode;  // Set by --numa: workers are spread over the nodes and first-touch their own slice
+extern int num_numa_nodes;
+extern int numa_node_ids[MAX_NUMA_NODES];  // sysfs node number of each detected node
+extern int num_numa_cpus;
+extern int numa_cpus[MAX_THREADS];  // Pool slot -> CPU, interleaved across nodes
+extern int numa_cpu_node[MAX_THREADS];  // Pool slot -> index into numa_node_ids
+extern int num_placement_cpus;  // Set by --scaling while it runs one SMT placement
+extern int placement_cpus[MAX_THREADS];  // Pool slot -> CPU for that placement
+
+extern uint64_t timer_overhead;  // Cycles of an empty kernel call, subtracted from every sample
+extern double tsc_hz;  // TSC ticks per second, set once by calibrate_tsc
+extern const char* tsc_source;  // Where tsc_hz came from, for the report
+
+extern uint32_t cpu_features;  // Bitmask of FEATURE_* supported by this host, set by detect_cpu_features
+extern int has_clflushopt;  // CPUID.(EAX=7,ECX=0):EBX bit 23, selects the cold-cache flush instruction
+
+// The registries; the harness sizes static tables by the last three, so they are declared with
+// their length and the definitions in libsum.c fail to compile if an entry is added without it
+extern kernel_entry kernels[];
+extern const int num_kernels;
+extern const wide_entry wide_kernels[];
+extern const int num_wide_kernels;
+extern const batch_entry batch_kernels[];
+extern const int num_batch_kernels;
+extern const aggregate_entry aggregate_kernels[3];
+extern const int num_aggregate_kernels;
+extern const filter_entry filter_kernels[4];
+extern const int num_filter_kernels;
+extern packed_entry packed_kernels[6];
+extern const int num_packed_kernels;
+
+uint64_t SingleScalar(uint64_t count, uint64_t* input_data);
+uint64_t Unroll2Scalar(uint64_t count, uint64_t* input_data);
+uint64_t Unroll4Scalar(uint64_t count, uint64_t* input_data);
+uint64_t Unroll8Scalar(uint64_t count, uint64_t* input_data);
+uint64_t Unroll16Scalar(uint64_t count, uint64_t* input_data);
+uint64_t Simd128(uint64_t count, uint64_t* input_data);
+uint64_t Simd256(uint64_t count, uint64_t* input_data);
+uint64_t Simd256x4(uint64_t count, uint64_t* input_data);
+uint64_t Simd256x8(uint64_t count, uint64_t* input_data);
+uint64_t Simd512(uint64_t count, uint64_t* input_data);
+uint64_t Simd512x4(uint64_t count, uint64_t* input_data);
+void AggregateScalar(uint64_t count, const uint64_t* input_data, aggregate_stats* stats);
+
+void measure_timer_overhead(void);
+void calibrate_tsc(void);
+
+void detect_cpu_features(void);
+int kernel_supported(const kernel_entry* kernel);
+const kernel_entry* best_kernel(uint64_t size);
+const wide_entry* wide_kernel(uint64_t (*func)(uint64_t, uint64_t*));
+const kernel_entry* find_kernel(const char* name);
+
+void pin_to_cpu(int n);
+void pool_init(int pin_caller);
+void pool_shutdown(void);
+void pool_resize(int workers);
+uint64_t pool_run(uint64_t (*chunk_func)(uint64_t, uint64_t*), uint64_t count, uint64_t* input_data, size_t elem_size,
+                  uint64_t align);
+uint64_t parallel_sum(parallel_kernel* kernel, uint64_t count, uint64_t* input_data);
+
+uint64_t pack_input(const uint64_t* data, uint64_t count, uint64_t* out, int encoding);
+
+void prefix_refresh(prefix_index* index);
+void prefix_rebuild(prefix_index* index);
+void prefix_build(prefix_index* index, uint64_t* data, uint64_t count);
+void prefix_free(prefix_index* index);
+void prefix_update(prefix_index* index, uint64_t i, uint64_t value);
+uint64_t prefix_range_sum(prefix_index* index, uint64_t first, uint64_t last);
+
+#endif
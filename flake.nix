@@ -17,6 +17,29 @@
         myPython = unstable.python312.withPackages (ps: with ps; [ numpy ]);
       in
       {
+        # The kernel library and the C harness at every optimization level, see csharp_comparison/Makefile. -O3 and PGO use
+        # -march=native and train on the build machine, so build it on the host you benchmark
+        packages.default = unstable.stdenv.mkDerivation {
+          pname = "computer-enhance-sum";
+          version = "0.1.0";
+          src = ./csharp_comparison;
+          buildFlags = [
+            "libsum.a"
+            "libsum.so"
+            "sum-O0"
+            "sum-O2"
+            "sum-O3"
+            "sum-pgo"
+          ];
+          installPhase = ''
+            mkdir -p $out/bin
+            cp sum-O0 sum-O2 sum-O3 sum-pgo $out/bin/
+            mkdir -p $out/lib $out/include
+            cp libsum.a libsum.so $out/lib/
+            cp sum.h $out/include/
+          '';
+        };
+
         devShell = unstable.mkShell {
           buildInputs = [
             unstable.nixfmt-rfc-style